@@ -7,6 +7,7 @@
 #include "Shader.hpp"
 #include "Texture.hpp"
 #include "OBJ_Loader.h"
+#include "FastObjLoader.hpp"
 
 Eigen::Matrix4f get_view_matrix(Eigen::Vector3f eye_pos)
 {
@@ -336,25 +337,49 @@ int main(int argc, const char** argv)
     bool command_line = false;
 
     std::string filename = "output.png";
+    // fastobj: parallel parser straight into indexed arrays; false: objl::Loader
+    bool use_fast_obj_loader = true;
     objl::Loader Loader;
     std::string obj_path = "../models/spot/";
+    std::string obj_file = obj_path + "spot_triangulated_good.obj";
 
     // Load .obj File
-    bool loadout = Loader.LoadFile("../models/spot/spot_triangulated_good.obj");
-    for(auto mesh:Loader.LoadedMeshes)
+    if (use_fast_obj_loader)
     {
-        for(int i=0;i<mesh.Vertices.size();i+=3)
+        fastobj::Mesh mesh;
+        if (!fastobj::load(obj_file, mesh))
+            std::cout << "Cannot open " << obj_file << "\n";
+        for(size_t i=0;i<mesh.numTriangles();i++)
         {
             Triangle* t = new Triangle();
             for(int j=0;j<3;j++)
             {
-                t->setVertex(j,Vector4f(mesh.Vertices[i+j].Position.X,mesh.Vertices[i+j].Position.Y,mesh.Vertices[i+j].Position.Z,1.0));
-                t->setNormal(j,Vector3f(mesh.Vertices[i+j].Normal.X,mesh.Vertices[i+j].Normal.Y,mesh.Vertices[i+j].Normal.Z));
-                t->setTexCoord(j,Vector2f(mesh.Vertices[i+j].TextureCoordinate.X, mesh.Vertices[i+j].TextureCoordinate.Y));
+                int p = mesh.positionIndices[3*i+j], n = mesh.normalIndices[3*i+j], uv = mesh.texcoordIndices[3*i+j];
+                t->setVertex(j,Vector4f(mesh.positions[3*p],mesh.positions[3*p+1],mesh.positions[3*p+2],1.0));
+                t->setNormal(j,n >= 0 ? Vector3f(mesh.normals[3*n],mesh.normals[3*n+1],mesh.normals[3*n+2]) : Vector3f(0,0,0));
+                t->setTexCoord(j,uv >= 0 ? Vector2f(mesh.texcoords[2*uv],mesh.texcoords[2*uv+1]) : Vector2f(0,0));
             }
             TriangleList.push_back(t);
         }
     }
+    else
+    {
+        Loader.LoadFile(obj_file);
+        for(auto mesh:Loader.LoadedMeshes)
+        {
+            for(int i=0;i<mesh.Vertices.size();i+=3)
+            {
+                Triangle* t = new Triangle();
+                for(int j=0;j<3;j++)
+                {
+                    t->setVertex(j,Vector4f(mesh.Vertices[i+j].Position.X,mesh.Vertices[i+j].Position.Y,mesh.Vertices[i+j].Position.Z,1.0));
+                    t->setNormal(j,Vector3f(mesh.Vertices[i+j].Normal.X,mesh.Vertices[i+j].Normal.Y,mesh.Vertices[i+j].Normal.Z));
+                    t->setTexCoord(j,Vector2f(mesh.Vertices[i+j].TextureCoordinate.X, mesh.Vertices[i+j].TextureCoordinate.Y));
+                }
+                TriangleList.push_back(t);
+            }
+        }
+    }
 
     rst::rasterizer r(700, 700);
 
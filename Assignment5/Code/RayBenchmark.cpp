@@ -0,0 +1,113 @@
+// Ray tracing throughput of this assignment's brute-force intersection (every
+// ray against every triangle) on the bundled models: closest-hit Mrays/s for
+// coherent, random and incoherent rays and the bare triangle and sphere
+// kernels. Single threaded, fixed seed, the same rays and JSON report as the
+// Assignment6 and Assignment7 benchmarks. Without an acceleration structure
+// there is no build to time and no any-hit query, and the defaults trace
+// fewer rays in fewer trials.
+//
+// usage: RayBenchmark [out.json=ray_benchmark.json] [rays=4096] [trials=5] [file.obj ...]
+//        (default: bunny, spot and HanabiBomb, run from the build directory)
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "RayBenchmark.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+
+namespace {
+
+const uint64_t Seed = 1;
+
+struct BenchRay
+{
+    Vector3f origin, direction;
+};
+
+std::vector<BenchRay> toRays(const raybench::RaySet& set)
+{
+    std::vector<BenchRay> rays;
+    rays.reserve(set.rays.size());
+    for (const raybench::Ray& r : set.rays)
+        rays.push_back({Vector3f(r.o[0], r.o[1], r.o[2]), Vector3f(r.d[0], r.d[1], r.d[2])});
+    return rays;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string output = argc > 1 ? argv[1] : "ray_benchmark.json";
+    size_t numRays = argc > 2 ? (size_t)std::atol(argv[2]) : 4096;
+    int trials = argc > 3 ? std::atoi(argv[3]) : 5;
+    std::vector<std::string> files;
+    for (int a = 4; a < argc; ++a)
+        files.push_back(argv[a]);
+    if (files.empty())
+        files = {"../../../Assignment6/Code/models/bunny/bunny.obj",
+                 "../../../Assignment3/Code/models/spot/spot_triangulated_good.obj",
+                 "../../../Assignment7/Code/models/HanabiBomb.obj"};
+
+    raybench::Report report("Assignment5", Seed, numRays, trials);
+    for (const std::string& file : files) {
+        raybench::Model model;
+        if (!raybench::loadModel(file, model)) {
+            fprintf(stderr, "Cannot load %s\n", file.c_str());
+            continue;
+        }
+        std::vector<Vector3f> vertices;
+        for (size_t i = 0; i < model.positions.size(); i += 3)
+            vertices.emplace_back(model.positions[i], model.positions[i + 1], model.positions[i + 2]);
+        std::vector<uint32_t> indices(model.indices.begin(), model.indices.end());
+        std::vector<Vector2f> st(vertices.size(), Vector2f(0, 0));
+        MeshTriangle mesh(vertices.data(), indices.data(), (uint32_t)model.numTriangles(), st.data());
+
+        std::vector<raybench::RaySet> sets = raybench::makeRaySets(model, numRays, Seed);
+        for (const raybench::RaySet& set : sets) {
+            std::vector<BenchRay> rays = toRays(set);
+            uint64_t hits = 0;
+            std::vector<double> closest = raybench::throughput(trials, rays.size(), [&] {
+                hits = 0;
+                for (const BenchRay& ray : rays) {
+                    float tNear = kInfinity;
+                    uint32_t index;
+                    Vector2f uv;
+                    hits += mesh.intersect(ray.origin, ray.direction, tNear, index, uv);
+                }
+            });
+            report.add({model.name, "brute-force", "closest_hit", set.name, "Mrays/s",
+                        raybench::summarize(closest), hits});
+        }
+
+        // kernels: ray i against triangle i % n, the random rays against a sphere around the model
+        raybench::RaySet aimed = raybench::makeKernelRays(model, numRays, Seed);
+        std::vector<BenchRay> rays = toRays(aimed);
+        uint64_t hits = 0;
+        std::vector<double> triangle = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            for (size_t i = 0; i < rays.size(); ++i) {
+                size_t tri = i % model.numTriangles();
+                float t, u, v;
+                hits += rayTriangleIntersect(vertices[indices[3 * tri]], vertices[indices[3 * tri + 1]],
+                                             vertices[indices[3 * tri + 2]], rays[i].origin, rays[i].direction,
+                                             t, u, v);
+            }
+        });
+        report.add({model.name, "kernel", "triangle", aimed.name, "Mtests/s", raybench::summarize(triangle), hits});
+        rays = toRays(sets[1]);
+        Vector3f lo(model.lo[0], model.lo[1], model.lo[2]), hi(model.hi[0], model.hi[1], model.hi[2]);
+        Sphere sphere((lo + hi) * 0.5f, 0.25f * std::sqrt(dotProduct(hi - lo, hi - lo)));
+        std::vector<double> sphereRate = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            for (const BenchRay& ray : rays) {
+                float tNear = kInfinity;
+                uint32_t index;
+                Vector2f uv;
+                hits += sphere.intersect(ray.origin, ray.direction, tNear, index, uv);
+            }
+        });
+        report.add({model.name, "kernel", "sphere", "random", "Mtests/s", raybench::summarize(sphereRate), hits});
+    }
+    return report.write(output) ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Ray tracing throughput of this assignment's BVH on the bundled models:
+// build time, closest-hit Mrays/s for coherent, random and incoherent rays,
+// and the bare triangle and sphere kernels. Single threaded, fixed seed, the
+// same rays and JSON report as the Assignment5 and Assignment7 benchmarks.
+// There is no any-hit query here (BVHAccel::IntersectP is not implemented),
+// shadow rays use Intersect as well.
+//
+// usage: RayBenchmark [out.json=ray_benchmark.json] [rays=65536] [trials=11] [file.obj ...]
+//        (default: bunny, spot and HanabiBomb, run from the build directory)
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "BVH.hpp"
+#include "RayBenchmark.hpp"
+#include "Sphere.hpp"
+#include "Triangle.hpp"
+
+namespace {
+
+const uint64_t Seed = 1;
+
+std::vector<Ray> toRays(const raybench::RaySet& set)
+{
+    std::vector<Ray> rays;
+    rays.reserve(set.rays.size());
+    for (const raybench::Ray& r : set.rays)
+        rays.emplace_back(Vector3f(r.o[0], r.o[1], r.o[2]), Vector3f(r.d[0], r.d[1], r.d[2]));
+    return rays;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string output = argc > 1 ? argv[1] : "ray_benchmark.json";
+    size_t numRays = argc > 2 ? (size_t)std::atol(argv[2]) : 65536;
+    int trials = argc > 3 ? std::atoi(argv[3]) : 11;
+    std::vector<std::string> files;
+    for (int a = 4; a < argc; ++a)
+        files.push_back(argv[a]);
+    if (files.empty())
+        files = {"../models/bunny/bunny.obj", "../../../Assignment3/Code/models/spot/spot_triangulated_good.obj",
+                 "../../../Assignment7/Code/models/HanabiBomb.obj"};
+
+    Material material;
+    raybench::Report report("Assignment6", Seed, numRays, trials);
+    for (const std::string& file : files) {
+        raybench::Model model;
+        if (!raybench::loadModel(file, model)) {
+            fprintf(stderr, "Cannot load %s\n", file.c_str());
+            continue;
+        }
+        std::vector<Triangle> triangles;
+        triangles.reserve(model.numTriangles());
+        for (size_t t = 0; t < model.numTriangles(); ++t) {
+            const float* p[3] = {model.corner(t, 0), model.corner(t, 1), model.corner(t, 2)};
+            triangles.emplace_back(Vector3f(p[0][0], p[0][1], p[0][2]), Vector3f(p[1][0], p[1][1], p[1][2]),
+                                   Vector3f(p[2][0], p[2][1], p[2][2]), &material);
+        }
+        std::vector<Object*> objects;
+        for (Triangle& triangle : triangles)
+            objects.push_back(&triangle);
+
+        // BVHAccel has no destructor, the trees of the build trials stay allocated until exit
+        BVHAccel* bvh = nullptr;
+        std::vector<double> buildMs;
+        for (int t = 0; t < trials; ++t)
+            buildMs.push_back(1e3 * raybench::seconds([&] { bvh = new BVHAccel(objects); }));
+        report.add({model.name, "binary", "build", "-", "ms", raybench::summarize(buildMs), model.numTriangles()});
+
+        std::vector<raybench::RaySet> sets = raybench::makeRaySets(model, numRays, Seed);
+        for (const raybench::RaySet& set : sets) {
+            std::vector<Ray> rays = toRays(set);
+            uint64_t hits = 0;
+            std::vector<double> closest = raybench::throughput(trials, rays.size(), [&] {
+                hits = 0;
+                for (const Ray& ray : rays)
+                    hits += bvh->Intersect(ray).happened;
+            });
+            report.add({model.name, "binary", "closest_hit", set.name, "Mrays/s", raybench::summarize(closest), hits});
+        }
+
+        // kernels: ray i against triangle i % n, the random rays against a sphere around the model
+        raybench::RaySet aimed = raybench::makeKernelRays(model, numRays, Seed);
+        std::vector<Ray> rays = toRays(aimed);
+        uint64_t hits = 0;
+        std::vector<double> triangle = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            for (size_t i = 0; i < rays.size(); ++i)
+                hits += triangles[i % triangles.size()].getIntersection(rays[i]).happened;
+        });
+        report.add({model.name, "kernel", "triangle", aimed.name, "Mtests/s", raybench::summarize(triangle), hits});
+        rays = toRays(sets[1]);
+        Vector3f lo(model.lo[0], model.lo[1], model.lo[2]), hi(model.hi[0], model.hi[1], model.hi[2]);
+        Sphere sphere((lo + hi) * 0.5f, 0.25f * std::sqrt(dotProduct(hi - lo, hi - lo)));
+        std::vector<double> sphereRate = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            for (const Ray& ray : rays)
+                hits += sphere.intersect(ray);
+        });
+        report.add({model.name, "kernel", "sphere", "random", "Mtests/s", raybench::summarize(sphereRate), hits});
+    }
+    return report.write(output) ? 0 : 1;
+}
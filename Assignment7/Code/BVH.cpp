@@ -1,199 +1,438 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <future>
+#include <string>
 #include "BVH.hpp"
 
+// Per-primitive data cached once before the build, so the builder never calls
+// back into Object::getBounds()
+struct BVHPrimitiveInfo {
+    BVHPrimitiveInfo() {}
+    BVHPrimitiveInfo(int primitiveNumber, const Bounds3& bounds)
+        : primitiveNumber(primitiveNumber), bounds(bounds),
+          centroid(0.5f * bounds.pMin + 0.5f * bounds.pMax) {}
+    int primitiveNumber;
+    Bounds3 bounds;
+    Vector3f centroid;
+};
+
 BVHAccel::BVHAccel(std::vector<Object*> p, int maxPrimsInNode,
-                   SplitMethod splitMethod)
+                   SplitMethod splitMethod, NodeLayout layout)
+    : maxPrimsInNode(std::min(255, maxPrimsInNode)), splitMethod(splitMethod),
+      layout(layout), primitives(std::move(p))
+{
+    std::vector<BVHPrimitiveInfo> primitiveInfo(primitives.size());
+    for (size_t i = 0; i < primitives.size(); ++i)
+        primitiveInfo[i] = BVHPrimitiveInfo((int)i, primitives[i]->getBounds());
+    build(primitiveInfo);
+
+    // primitiveInfo has been partitioned in place into leaf order
+    orderedPrims.resize(primitives.size());
+    for (size_t i = 0; i < primitiveInfo.size(); ++i)
+        orderedPrims[i] = primitives[primitiveInfo[i].primitiveNumber];
+}
+
+BVHAccel::BVHAccel(TriangleMesh* mesh, int maxPrimsInNode, SplitMethod splitMethod,
+                   NodeLayout layout)
+    : maxPrimsInNode(std::min(255, maxPrimsInNode)), splitMethod(splitMethod),
+      layout(layout), mesh(mesh)
+{
+    std::vector<BVHPrimitiveInfo> primitiveInfo(mesh->numTriangles());
+    for (size_t i = 0; i < primitiveInfo.size(); ++i)
+        primitiveInfo[i] = BVHPrimitiveInfo((int)i, mesh->triangleBounds(i));
+    build(primitiveInfo);
+
+    // store the triangles in leaf order so every leaf is a contiguous range
+    std::vector<int> order(primitiveInfo.size());
+    for (size_t i = 0; i < primitiveInfo.size(); ++i)
+        order[i] = primitiveInfo[i].primitiveNumber;
+    mesh->reorder(order);
+}
+
+BVHAccel::BVHAccel(TriangleMesh* mesh, std::vector<LinearBVHNode> flatNodes, int maxPrimsInNode,
+                   SplitMethod splitMethod, NodeLayout layout)
     : maxPrimsInNode(std::min(255, maxPrimsInNode)), splitMethod(splitMethod),
-      primitives(std::move(p))
+      layout(layout), mesh(mesh), totalNodes((int)flatNodes.size()), nodes(std::move(flatNodes))
 {
-    time_t start, stop;
-    time(&start);
-    if (primitives.empty())
+    if (layout != NodeLayout::BINARY && !nodes.empty())
+        wideNodes.build(nodes, layout == NodeLayout::BVH4 ? 4 : 8);
+}
+
+void BVHAccel::build(std::vector<BVHPrimitiveInfo>& primitiveInfo)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (primitiveInfo.empty())
         return;
 
-    root = recursiveBuild(primitives);
+    // a binary tree over n primitives has at most 2n - 1 nodes: one block holds them all
+    arena = MemoryArena((2 * primitiveInfo.size() - 1) * sizeof(SplitBuildNode));
+    root = recursiveBuild(arena, primitiveInfo, 0, (int)primitiveInfo.size(), 0);
 
-    time(&stop);
-    double diff = difftime(stop, start);
-    int hrs = (int)diff / 3600;
-    int mins = ((int)diff / 60) - (hrs * 60);
-    int secs = (int)diff - (hrs * 3600) - (mins * 60);
+    nodes.reserve(totalNodes);
+    nodes.resize(1);
+    flattenBVHTree(root, 0);
 
-    printf(
-        "\rBVH Generation complete: \nTime Taken: %i hrs, %i mins, %i secs\n\n",
-        hrs, mins, secs);
+    std::string layoutName = "binary";
+    if (layout != NodeLayout::BINARY) {
+        wideNodes.build(nodes, layout == NodeLayout::BVH4 ? 4 : 8);
+        layoutName = std::string(layout == NodeLayout::BVH4 ? "BVH4 " : "BVH8 ") + wideNodes.isaName();
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    if (printStats)
+        printf("\rBVH Generation complete: %d primitives, %d nodes, %s layout\n"
+               "Build nodes: %.1f KB in %.1f KB of arena, flattened: %.1f KB\nTime Taken: %.3f ms\n\n",
+               (int)primitiveInfo.size(), (int)totalNodes, layoutName.c_str(), arena.bytesAllocated() / 1024.0,
+               arena.bytesReserved() / 1024.0, nodes.size() * sizeof(LinearBVHNode) / 1024.0,
+               std::chrono::duration<double, std::milli>(stop - start).count());
 }
 
 // TODO MISSION
-SplitBuildNode* BVHAccel::recursiveBuild(std::vector<Object*> objects)
+SplitBuildNode* BVHAccel::recursiveBuild(MemoryArena& arena, std::vector<BVHPrimitiveInfo>& primitiveInfo,
+                                         int start, int end, int depth)
 {
-    SplitBuildNode* node = new SplitBuildNode();
+    // parents before children, left subtree before right: depth first in memory
+    SplitBuildNode* node = arena.alloc<SplitBuildNode>();
+    totalNodes++;
 
     // Compute bounds of all primitives in BVH node
     Bounds3 bounds;
-    for (int i = 0; i < objects.size(); ++i)
-        bounds = Union(bounds, objects[i]->getBounds());
-    if (objects.size() == 1) {
-        // Create leaf _BVHBuildNode_
-        node->bounds = objects[0]->getBounds();
-        node->object = objects[0];
-        node->left = nullptr;
-        node->right = nullptr;
-        return node;
-    }
-    else if (objects.size() == 2) {
-        node->left = recursiveBuild(std::vector{objects[0]});
-        node->right = recursiveBuild(std::vector{objects[1]});
+    for (int i = start; i < end; ++i)
+        bounds = Union(bounds, primitiveInfo[i].bounds);
 
-        node->bounds = Union(node->left->bounds, node->right->bounds);
+    int nPrimitives = end - start;
+    // Create leaf _BVHBuildNode_ over the contiguous range [start, end)
+    auto makeLeaf = [&] {
+        node->bounds = bounds;
+        node->firstPrimOffset = start;
+        node->nPrimitives = nPrimitives;
+        if (!mesh && nPrimitives == 1)
+            node->object = primitives[primitiveInfo[start].primitiveNumber];
         return node;
+    };
+    if (nPrimitives == 1 || (splitMethod == SplitMethod::NAIVE && nPrimitives <= maxPrimsInNode))
+        return makeLeaf();
+
+    Bounds3 centroidBounds;
+    for (int i = start; i < end; ++i)
+        centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+    int dim = centroidBounds.maxExtent();
+    node->splitAxis = dim;
+
+    const Vector3f& cMin = centroidBounds.pMin;
+    const Vector3f& cMax = centroidBounds.pMax;
+    int mid = (start + end) / 2;
+    if (cMax[dim] == cMin[dim]) {
+        // all centroids coincide, nothing to bin: one leaf if it fits, else split by count
+        if (nPrimitives <= maxPrimsInNode)
+            return makeLeaf();
     }
-    else 
-    {
-        Bounds3 centroidBounds;
-        for (int i = 0; i < objects.size(); ++i)
-            centroidBounds = Union(centroidBounds, objects[i]->getBounds().Centroid());
-        int dim = centroidBounds.maxExtent();
-        switch (dim) 
-        {
-        case 0:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().x < f2->getBounds().Centroid().x;
-            });
-            break;
-        case 1:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().y < f2->getBounds().Centroid().y;
-            });
-            break;
-        case 2:
-            std::sort(objects.begin(), objects.end(), [](auto f1, auto f2) {
-                return f1->getBounds().Centroid().z < f2->getBounds().Centroid().z;
-            });
-            break;
+    else if (splitMethod == SplitMethod::NAIVE || (nPrimitives <= 2 && nPrimitives > maxPrimsInNode)) {
+        std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+                         [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                             return a.centroid[dim] < b.centroid[dim];
+                         });
+    }
+    else {
+        // Binned SAH: bucket the centroids, sweep the bucket boundaries
+        struct BucketInfo {
+            int count = 0;
+            Bounds3 bounds;
+        };
+        BucketInfo buckets[nBuckets];
+        // non-finite centroids (an empty Bounds3 has a NaN one) go to bucket 0
+        auto bucketOf = [&](const BVHPrimitiveInfo& pi) {
+            double offset = (pi.centroid[dim] - cMin[dim]) / (cMax[dim] - cMin[dim]);
+            if (!(offset >= 0))
+                return 0;
+            return offset >= 1 ? nBuckets - 1 : std::min((int)(nBuckets * offset), nBuckets - 1);
+        };
+        for (int i = start; i < end; ++i) {
+            int b = bucketOf(primitiveInfo[i]);
+            buckets[b].count++;
+            buckets[b].bounds = Union(buckets[b].bounds, primitiveInfo[i].bounds);
         }
 
-        switch(splitMethod) 
-        {
-            case SplitMethod::NAIVE:
-            {
-                auto beginning = objects.begin();
-                auto middling = objects.begin() + (objects.size() / 2);
-                auto ending = objects.end();
-            
-                auto leftshapes = std::vector<Object*>(beginning, middling);
-                auto rightshapes = std::vector<Object*>(middling, ending);
-            
-                assert(objects.size() == (leftshapes.size() + rightshapes.size()));
-            
-                node->left = recursiveBuild(leftshapes);
-                node->right = recursiveBuild(rightshapes);
-            
-                node->bounds = Union(node->left->bounds, node->right->bounds);
+        // cost[i]: split after bucket i; sweep from the right, then from the left
+        float cost[nBuckets - 1];
+        Bounds3 rightBounds;
+        int rightCount = 0;
+        for (int i = nBuckets - 1; i >= 1; --i) {
+            rightBounds = Union(rightBounds, buckets[i].bounds);
+            rightCount += buckets[i].count;
+            cost[i - 1] = rightCount ? rightCount * rightBounds.SurfaceArea() : 0;
+        }
+        Bounds3 leftBounds;
+        int leftCount = 0;
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            leftBounds = Union(leftBounds, buckets[i].bounds);
+            leftCount += buckets[i].count;
+            cost[i] += leftCount ? leftCount * leftBounds.SurfaceArea() : 0;
+        }
 
-                break;
-            }   
-            case SplitMethod::SAH:
-            {
-                float SN = centroidBounds.SurfaceArea();
-                int B = 10;
-                int mincostIndex = 0;
-                float minCost = std::numeric_limits<float>::infinity(); //最小花费
-
-                for (int i = 1; i < B; i++)
-                {
-                    auto beginning = objects.begin();
-                    auto middling = objects.begin() + (objects.size() * i / B);
-                    auto ending = objects.end();
-                    auto leftshapes = std::vector<Object*>(beginning, middling);
-                    auto rightshapes = std::vector<Object*>(middling, ending);
-                    //求左右包围盒:
-                    Bounds3 leftBounds, rightBounds;
-                    for (int k = 0; k < leftshapes.size(); ++k)
-                        leftBounds = Union(leftBounds, leftshapes[k]->getBounds().Centroid());
-                    for (int k = 0; k < rightshapes.size(); ++k)
-                        rightBounds = Union(rightBounds, rightshapes[k]->getBounds().Centroid());
-                    float SA = leftBounds.SurfaceArea(); //SA
-                    float SB = rightBounds.SurfaceArea(); //SB
-                    float cost = 0.125 + (leftshapes.size() * SA + rightshapes.size() * SB) / SN; //计算花费
-                    if (cost < minCost) //如果花费更小，记录当前坐标值
-                    {
-                        minCost = cost;
-                        mincostIndex = i;
-                    }
-                }
-                //找到mincostIndex后的操作等同于BVH
-                auto beginning = objects.begin();
-                auto middling = objects.begin() + (objects.size() * mincostIndex / B);//划分点选为当前最优桶的位置
-                auto ending = objects.end();
-                auto leftshapes = std::vector<Object*>(beginning, middling); //数组切分
-                auto rightshapes = std::vector<Object*>(middling, ending);
-
-                assert(objects.size() == (leftshapes.size() + rightshapes.size()));
-
-                node->left = recursiveBuild(leftshapes); //左右开始递归
-                node->right = recursiveBuild(rightshapes);
-                node->bounds = Union(node->left->bounds, node->right->bounds);//返回pMin pMax构成大包围盒
-                break;
+        int minCostSplitBucket = -1;
+        float minCost = std::numeric_limits<float>::infinity();
+        double invSN = 1.0 / bounds.SurfaceArea();
+        leftCount = 0;
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            leftCount += buckets[i].count;
+            if (leftCount == 0 || leftCount == nPrimitives)
+                continue;
+            float c = traversalCost + cost[i] * invSN;
+            if (c < minCost) {
+                minCost = c;
+                minCostSplitBucket = i;
             }
         }
 
-        return node;
+        // a leaf costs one intersection per primitive; keep the range together
+        // when it fits and no split is cheaper
+        if (nPrimitives <= maxPrimsInNode && (minCostSplitBucket < 0 || minCost >= nPrimitives))
+            return makeLeaf();
+
+        if (minCostSplitBucket >= 0) {
+            BVHPrimitiveInfo* pmid = std::partition(
+                &primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+                [&](const BVHPrimitiveInfo& pi) { return bucketOf(pi) <= minCostSplitBucket; });
+            mid = (int)(pmid - &primitiveInfo[0]);
+        }
     }
+
+    // Build the two halves in parallel near the top of large trees
+    // (the left half gets an arena of its own, merged back when it is done)
+    if (nPrimitives >= parallelBuildThreshold && depth < maxParallelDepth) {
+        MemoryArena leftArena(2 * (mid - start) * sizeof(SplitBuildNode));
+        auto leftTask = std::async(std::launch::async, [&] {
+            return recursiveBuild(leftArena, primitiveInfo, start, mid, depth + 1);
+        });
+        node->right = recursiveBuild(arena, primitiveInfo, mid, end, depth + 1);
+        node->left = leftTask.get();
+        arena.adopt(std::move(leftArena));
+    }
+    else {
+        node->left = recursiveBuild(arena, primitiveInfo, start, mid, depth + 1);
+        node->right = recursiveBuild(arena, primitiveInfo, mid, end, depth + 1);
+    }
+    node->bounds = Union(node->left->bounds, node->right->bounds);
+    return node;
 }
 
-// TODO MISSION
-Intersection BVHAccel::Intersect(const Ray& ray) const
+// the build nodes go with the arena, all at once
+BVHAccel::~BVHAccel() = default;
+
+Bounds3 BVHAccel::WorldBound() const
 {
-    Intersection isect;
-    if (!root)
-        return isect;
-    isect = BVHAccel::getIntersection(root, ray);
-    return isect;
+    return nodes.empty() ? Bounds3() : nodes[0].bounds;
+}
+
+// Lay the build tree out depth first, keeping the two children of every
+// interior node adjacent
+void BVHAccel::flattenBVHTree(SplitBuildNode* node, int offset)
+{
+    nodes[offset].bounds = node->bounds;
+    if (node->nPrimitives > 0) {
+        nodes[offset].primitivesOffset = node->firstPrimOffset;
+        nodes[offset].nPrimitives = (uint16_t)node->nPrimitives;
+        return;
+    }
+    int childOffset = (int)nodes.size();
+    nodes.resize(childOffset + 2);
+    nodes[offset].childOffset = childOffset;
+    nodes[offset].nPrimitives = 0;
+    nodes[offset].axis = (uint8_t)node->splitAxis;
+    flattenBVHTree(node->left, childOffset);
+    flattenBVHTree(node->right, childOffset + 1);
+}
+
+// Ordered front-to-back walk of the flattened tree with an explicit stack.
+// leaf(first, count) intersects a leaf's primitive range, may shrink tMax so
+// farther boxes get culled, and returns true to stop the traversal early.
+template <typename LeafFn>
+void BVHAccel::traverse(const Ray& ray, const float& tMax, LeafFn&& leaf) const
+{
+    if (!wideNodes.empty()) {
+        wideNodes.traverse(ray, tMax, leaf);
+        return;
+    }
+
+    const Vector3f& invDir = ray.direction_inv;
+    const int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+    int toVisit[64];
+    int toVisitOffset = 0, current = 0;
+    while (true) {
+        const LinearBVHNode& node = nodes[current];
+        STAT(++Stats::local().nodesVisited; ++Stats::local().boxTests);
+        if (node.bounds.IntersectP(ray, invDir, dirIsNeg, tMax)) {
+            if (node.nPrimitives > 0) {
+                STAT(Stats::local().primitiveTests += node.nPrimitives);
+                if (leaf(node.primitivesOffset, node.nPrimitives))
+                    return;
+                if (toVisitOffset == 0)
+                    break;
+                current = toVisit[--toVisitOffset];
+            }
+            else {
+                // visit the near child first, the far one may then be culled by tMax
+                toVisit[toVisitOffset++] = node.childOffset + 1 - dirIsNeg[node.axis];
+                current = node.childOffset + dirIsNeg[node.axis];
+            }
+        }
+        else {
+            if (toVisitOffset == 0)
+                break;
+            current = toVisit[--toVisitOffset];
+        }
+    }
 }
 
 // TODO MISSION
-Intersection BVHAccel::getIntersection(SplitBuildNode* node, const Ray& ray) const
+Intersection BVHAccel::Intersect(const Ray& ray) const
 {
-    // TODO Traverse the BVH to find intersection
-    Intersection isect;
+    HitRecord hit(ray);
+    return closestHit(ray, hit) ? surfaceInteraction(ray, hit) : Intersection();
+}
 
-    if (!node->bounds.IntersectP(ray))
-        return isect;
+// Traversal only tracks (t, primitive, barycentrics); the hit is filled in
+// once at the end by surfaceInteraction()
+bool BVHAccel::closestHit(const Ray& ray, HitRecord& hit) const
+{
+    if (nodes.empty())
+        return false;
 
-    if (node->object != nullptr) {
-        isect = node->object->getIntersection(ray);
-        return isect;
+    float& tMax = hit.t;
+    bool found = false;
+    if (mesh) {
+        traverse(ray, tMax, [&](int first, int count) {
+            found |= mesh->intersect(ray, first, count, tMax, hit.primId, hit.u, hit.v);
+            return false;
+        });
+        return found;
     }
-    Intersection leftIsect = getIntersection(node->left, ray);
-    Intersection rightIsect = getIntersection(node->right, ray);
-    if (leftIsect.happened && rightIsect.happened) {
-        if (leftIsect.distance < rightIsect.distance)
-            return leftIsect;
+
+    traverse(ray, tMax, [&](int first, int count) {
+        for (int i = first; i < first + count; ++i)
+            found |= orderedPrims[i]->closestHit(ray, hit);
+        return false;
+    });
+    return found;
+}
+
+SurfaceInteraction BVHAccel::surfaceInteraction(const Ray& ray, const HitRecord& hit) const
+{
+    if (!mesh)
+        return hit.obj->surfaceInteraction(ray, hit);
+
+    SurfaceInteraction isect;
+    isect.happened = true;
+    isect.distance = hit.t;
+    isect.coords = ray(hit.t);
+    isect.normal = mesh->shadingNormal(hit.primId, hit.u, hit.v);
+    isect.geometricNormal = mesh->normal(hit.primId);
+    Vector2f st = mesh->texcoord(hit.primId, hit.u, hit.v);
+    isect.tcoords = Vector3f(st.x, st.y, 0.0f);
+    isect.m = mesh->material(hit.primId);
+    isect.primId = hit.primId;
+    return isect;
+}
+
+// Any-hit query for shadow rays: stops at the first primitive that blocks
+// [0, ray.t_max) and never builds an Intersection
+bool BVHAccel::IntersectP(const Ray& ray) const
+{
+    if (nodes.empty())
+        return false;
+
+    float tMax = (float)std::min(ray.t_max, (double)kInfinity);
+    bool occluded = false;
+    traverse(ray, tMax, [&](int first, int count) {
+        if (mesh)
+            occluded = mesh->intersectP(ray, first, count, tMax);
         else
-            return rightIsect;
-    }
-    else if (leftIsect.happened)
-        return leftIsect;
-    else if (rightIsect.happened)
-        return rightIsect;
-    else
-        return isect;
+            for (int i = first; i < first + count && !occluded; ++i)
+                occluded = orderedPrims[i]->intersect(ray);
+        return occluded;
+    });
+    return occluded;
 }
 
-void BVHAccel::getSample(SplitBuildNode* node, float p, Intersection &pos, float &pdf){
-    if(node->left == nullptr || node->right == nullptr){
-        node->object->Sample(pos, pdf);
-        pdf *= node->area;
-        return;
+// Packet traversal over the binary nodes (also kept for the wide layouts):
+// the whole packet visits a node unless the interval test proves that no ray
+// can enter it, or no ray is found that actually does. Near/far child order
+// follows the first active ray, which suits the whole packet when coherent.
+uint64_t BVHAccel::closestHits(RayPacket& packet, HitRecord* hits) const
+{
+    const int n = packet.size();
+    if (nodes.empty() || n == 0)
+        return 0;
+
+    int dirIsNeg[RayPacket::MaxRays][3];
+    for (int i = 0; i < n; ++i) {
+        const Vector3f& invDir = packet.rays[i].direction_inv;
+        for (int axis = 0; axis < 3; ++axis)
+            dirIsNeg[i][axis] = invDir[axis] < 0;
+    }
+    auto rayHitsBox = [&](int i, const Bounds3& bounds) {
+        STAT(++Stats::local().boxTests);
+        const Ray& ray = packet.rays[i];
+        return bounds.IntersectP(ray, ray.direction_inv, dirIsNeg[i], packet.tMax[i]);
+    };
+
+    RayPacket::Interval interval = packet.interval();
+    uint64_t hitMask = 0;
+
+    int toVisit[64];
+    int toVisitOffset = 0, current = 0;
+    while (true) {
+        const LinearBVHNode& node = nodes[current];
+        STAT(++Stats::local().nodesVisited);
+        int firstActive = n;
+        if (interval.mayHit(node.bounds))
+            for (int i = 0; i < n; ++i)
+                if (rayHitsBox(i, node.bounds)) {
+                    firstActive = i;
+                    break;
+                }
+
+        if (firstActive < n && node.nPrimitives > 0) {
+            if (mesh) {
+                for (int i = firstActive; i < n; ++i)
+                    if (i == firstActive || rayHitsBox(i, node.bounds)) {
+                        STAT(Stats::local().primitiveTests += node.nPrimitives);
+                        if (mesh->intersect(packet.rays[i], node.primitivesOffset, node.nPrimitives,
+                                            packet.tMax[i], hits[i].primId, hits[i].u, hits[i].v)) {
+                            hits[i].t = packet.tMax[i];
+                            hitMask |= uint64_t(1) << i;
+                        }
+                    }
+            }
+            else {
+                STAT(Stats::local().primitiveTests += node.nPrimitives);
+                for (int k = 0; k < node.nPrimitives; ++k)
+                    hitMask |= orderedPrims[node.primitivesOffset + k]->closestHits(packet, hits);
+            }
+            interval.maxT = *std::max_element(packet.tMax, packet.tMax + n);
+        }
+        else if (firstActive < n) {
+            const int* neg = dirIsNeg[firstActive];
+            toVisit[toVisitOffset++] = node.childOffset + 1 - neg[node.axis];
+            current = node.childOffset + neg[node.axis];
+            continue;
+        }
+        if (toVisitOffset == 0)
+            break;
+        current = toVisit[--toVisitOffset];
     }
-    if(p < node->left->area) getSample(node->left, p, pos, pdf);
-    else getSample(node->right, p - node->left->area, pos, pdf);
+    return hitMask;
 }
 
-void BVHAccel::Sample(Intersection &pos, float &pdf){
-    float p = std::sqrt(get_random_float()) * root->area;
-    getSample(root, p, pos, pdf);
-    pdf /= root->area;
-}
\ No newline at end of file
+uint64_t BVHAccel::IntersectPacket(RayPacket& packet, Intersection* hits) const
+{
+    HitRecord records[RayPacket::MaxRays];
+    uint64_t hitMask = closestHits(packet, records);
+    for (int i = 0; i < packet.size(); ++i)
+        if (hitMask & (uint64_t(1) << i))
+            hits[i] = surfaceInteraction(packet.rays[i], records[i]);
+    return hitMask;
+}
@@ -8,17 +8,35 @@
 #include <atomic>
 #include <vector>
 #include <memory>
-#include <ctime>
 #include "Object.hpp"
 #include "Ray.hpp"
 #include "Bounds3.hpp"
 #include "Intersection.hpp"
+#include "MemoryArena.hpp"
+#include "Stats.hpp"
+#include "RayPacket.hpp"
+#include "TriangleMesh.hpp"
+#include "WideBVH.hpp"
 #include "Vector.hpp"
 
 struct SplitBuildNode;
 // BVHAccel Forward Declarations
 struct BVHPrimitiveInfo;
 
+// Flattened node: 32 bytes, the two children of an interior node are stored
+// next to each other at childOffset and childOffset + 1
+struct LinearBVHNode {
+    Bounds3 bounds;
+    union {
+        int primitivesOffset; // leaf
+        int childOffset;      // interior
+    };
+    uint16_t nPrimitives;     // 0 -> interior node
+    uint8_t axis;             // interior node: split axis
+    uint8_t pad[1];
+};
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should stay 32 bytes");
+
 // BVHAccel Declarations
 inline int leafNodes, totalLeafNodes, totalPrimitives, interiorNodes;
 class BVHAccel {
@@ -26,27 +44,64 @@ class BVHAccel {
 public:
     // BVHAccel Public Types
     enum class SplitMethod { NAIVE, SAH };
+    // traversal layout: the binary tree, or it collapsed to 4/8-wide SIMD nodes
+    enum class NodeLayout { BINARY, BVH4, BVH8 };
 
     // BVHAccel Public Methods
-    BVHAccel(std::vector<Object*> p, int maxPrimsInNode = 1, SplitMethod splitMethod = SplitMethod::NAIVE);
+    BVHAccel(std::vector<Object*> p, int maxPrimsInNode = 1, SplitMethod splitMethod = SplitMethod::NAIVE,
+             NodeLayout layout = NodeLayout::BINARY);
+    // bottom-level BVH over the triangles of a mesh, reorders them into leaf order
+    BVHAccel(TriangleMesh* mesh, int maxPrimsInNode = 1, SplitMethod splitMethod = SplitMethod::NAIVE,
+             NodeLayout layout = NodeLayout::BINARY);
+    // mesh BVH from an already flattened tree (see MeshCache), the mesh must be in its leaf order
+    BVHAccel(TriangleMesh* mesh, std::vector<LinearBVHNode> flatNodes, int maxPrimsInNode,
+             SplitMethod splitMethod, NodeLayout layout = NodeLayout::BINARY);
     Bounds3 WorldBound() const;
     ~BVHAccel();
 
+    // print the build summary of every BVH (benchmarks turn it off)
+    static inline bool printStats = true;
+
     Intersection Intersect(const Ray &ray) const;
-    Intersection getIntersection(SplitBuildNode* node, const Ray& ray)const;
     bool IntersectP(const Ray &ray) const;
-    SplitBuildNode* root;
+    // closest hits of a coherent packet, see Object::closestHits
+    uint64_t IntersectPacket(RayPacket& packet, Intersection* hits) const;
+    // Intersect split in two: the traversal with a compact HitRecord (same
+    // contract as Object::closestHit, obj stays unset for a mesh BVH), then the
+    // surface attributes of the final hit
+    bool closestHit(const Ray& ray, HitRecord& hit) const;
+    uint64_t closestHits(RayPacket& packet, HitRecord* hits) const;
+    SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit) const;
+    SplitBuildNode* root = nullptr;
 
     // BVHAccel Private Methods
-    SplitBuildNode* recursiveBuild(std::vector<Object*>objects);
+    void build(std::vector<BVHPrimitiveInfo>& primitiveInfo);
+    template <typename LeafFn>
+    void traverse(const Ray& ray, const float& tMax, LeafFn&& leaf) const;
+    SplitBuildNode* recursiveBuild(MemoryArena& arena, std::vector<BVHPrimitiveInfo>& primitiveInfo,
+                                   int start, int end, int depth);
+    void flattenBVHTree(SplitBuildNode* node, int offset);
 
     // BVHAccel Private Data
+    static constexpr int nBuckets = 16;
+    // SAH cost of visiting a node, relative to one primitive test; only
+    // weighs a split against a leaf, the best split does not depend on it
+    static constexpr float traversalCost = 1.0f;
+    static constexpr int parallelBuildThreshold = 4096;
+    static constexpr int maxParallelDepth = 4;
     const int maxPrimsInNode;
     const SplitMethod splitMethod;
+    const NodeLayout layout;
     std::vector<Object*> primitives;
-
-    void getSample(SplitBuildNode* node, float p, Intersection &pos, float &pdf);
-    void Sample(Intersection &pos, float &pdf);
+    // set for a mesh BVH: leaves are triangle ranges in the mesh instead of Objects
+    TriangleMesh* mesh = nullptr;
+    std::atomic<int> totalNodes{0};
+    // owns the SplitBuildNodes under root, laid out depth first
+    MemoryArena arena;
+    // flattened tree used for traversal, leaves index orderedPrims
+    std::vector<LinearBVHNode> nodes;
+    std::vector<Object*> orderedPrims;
+    WideBVH wideNodes;
 };
 
 struct SplitBuildNode {
@@ -54,7 +109,6 @@ struct SplitBuildNode {
     SplitBuildNode *left;
     SplitBuildNode *right;
     Object* object;
-    float area;
 
 public:
     int splitAxis=0, firstPrimOffset=0, nPrimitives=0;
@@ -85,6 +85,8 @@ class Bounds3
     }
 
     inline bool IntersectP(const Ray& ray) const;
+    inline bool IntersectP(const Ray& ray, const Vector3f& invDir,
+                           const int dirIsNeg[3], float tMax) const;
 };
 
 
@@ -119,6 +121,24 @@ inline bool Bounds3::IntersectP(const Ray& ray) const
     return true;
 }
 
+// Slab test against [0, tMax]; dirIsNeg picks the near/far plane per axis so
+// no swaps are needed
+inline bool Bounds3::IntersectP(const Ray& ray, const Vector3f& invDir,
+                                const int dirIsNeg[3], float tMax) const
+{
+    const Bounds3& bounds = *this;
+    float tEnter = (bounds[dirIsNeg[0]].x - ray.origin.x) * invDir.x;
+    float tExit = (bounds[1 - dirIsNeg[0]].x - ray.origin.x) * invDir.x;
+    float tyEnter = (bounds[dirIsNeg[1]].y - ray.origin.y) * invDir.y;
+    float tyExit = (bounds[1 - dirIsNeg[1]].y - ray.origin.y) * invDir.y;
+    float tzEnter = (bounds[dirIsNeg[2]].z - ray.origin.z) * invDir.z;
+    float tzExit = (bounds[1 - dirIsNeg[2]].z - ray.origin.z) * invDir.z;
+
+    tEnter = std::max(tEnter, std::max(tyEnter, tzEnter));
+    tExit = std::min(tExit, std::min(tyExit, tzExit));
+    return tEnter <= tExit && tExit >= 0 && tEnter <= tMax;
+}
+
 inline Bounds3 Union(const Bounds3& b1, const Bounds3& b2)
 {
     Bounds3 ret;
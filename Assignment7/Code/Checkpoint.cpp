@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "Checkpoint.hpp"
+#include "Scene.hpp"
+
+namespace {
+
+const char Magic[4] = {'R', 'T', 'C', 'P'};
+const uint32_t Version = 2;
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    int32_t width, height;
+    uint64_t key;
+    uint64_t seed;
+    uint64_t firstSample;
+    // stored pixels [x0, x1) x [y0, y1), the rest of the frame has no samples
+    int32_t x0, y0, x1, y1;
+};
+
+// FNV-1a over the raw bytes of each value
+struct Hasher
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    template <typename T>
+    void add(const T& value)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            h ^= bytes[i];
+            h *= 0x100000001b3ull;
+        }
+    }
+};
+
+} // namespace
+
+std::vector<Vector3f> Checkpoint::image() const
+{
+    std::vector<Vector3f> result(sum.size());
+    for (size_t p = 0; p < sum.size(); ++p)
+        result[p] = color((int)p);
+    return result;
+}
+
+uint32_t Checkpoint::maxSamples() const
+{
+    return count.empty() ? 0 : *std::max_element(count.begin(), count.end());
+}
+
+int Checkpoint::emptyPixels() const
+{
+    return (int)std::count(count.begin(), count.end(), 0u);
+}
+
+bool Checkpoint::load(const std::string& filename)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return false;
+    Header header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.magic, Magic, 4) == 0;
+    ok = ok && header.version == Version && header.width > 0 && header.height > 0 &&
+         0 <= header.x0 && header.x0 <= header.x1 && header.x1 <= header.width &&
+         0 <= header.y0 && header.y0 <= header.y1 && header.y1 <= header.height;
+    if (!ok) {
+        std::cerr << filename << " is not a version " << Version << " checkpoint\n";
+        fclose(fp);
+        return false;
+    }
+
+    width = header.width;
+    height = header.height;
+    key = header.key;
+    seed = header.seed;
+    firstSample = header.firstSample;
+    sum.assign((size_t)width * height, Vector3f(0.0f));
+    count.assign((size_t)width * height, 0);
+    size_t rowPixels = header.x1 - header.x0;
+    std::vector<float> rgb(3 * rowPixels);
+    for (int y = header.y0; y < header.y1 && ok; ++y) {
+        size_t row = (size_t)y * width + header.x0;
+        ok = fread(rgb.data(), sizeof(float), rgb.size(), fp) == rgb.size() &&
+             fread(&count[row], sizeof(uint32_t), rowPixels, fp) == rowPixels;
+        for (size_t i = 0; i < rowPixels; ++i)
+            sum[row + i] = Vector3f(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    }
+    fclose(fp);
+    if (!ok)
+        std::cerr << filename << " is truncated\n";
+    return ok;
+}
+
+bool Checkpoint::save(const std::string& filename) const
+{
+    std::string tmp = filename + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp) {
+        std::cerr << "Cannot write " << tmp << "\n";
+        return false;
+    }
+    Header header;
+    memcpy(header.magic, Magic, 4);
+    header.version = Version;
+    header.width = width;
+    header.height = height;
+    header.key = key;
+    header.seed = seed;
+    header.firstSample = firstSample;
+    // bounding rectangle of the sampled pixels
+    header.x0 = width; header.y0 = height; header.x1 = 0; header.y1 = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (count[y * width + x] == 0)
+                continue;
+            header.x0 = std::min(header.x0, x); header.x1 = std::max(header.x1, x + 1);
+            header.y0 = std::min(header.y0, y); header.y1 = std::max(header.y1, y + 1);
+        }
+    }
+    if (header.x1 == 0)
+        header.x0 = header.y0 = 0;
+
+    size_t rowPixels = header.x1 - header.x0;
+    std::vector<float> rgb(3 * rowPixels);
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (int y = header.y0; y < header.y1 && ok; ++y) {
+        size_t row = (size_t)y * width + header.x0;
+        for (size_t i = 0; i < rowPixels; ++i) {
+            rgb[3 * i] = sum[row + i].x;
+            rgb[3 * i + 1] = sum[row + i].y;
+            rgb[3 * i + 2] = sum[row + i].z;
+        }
+        ok = fwrite(rgb.data(), sizeof(float), rgb.size(), fp) == rgb.size() &&
+             fwrite(&count[row], sizeof(uint32_t), rowPixels, fp) == rowPixels;
+    }
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Cannot write " << filename << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::merge(const Checkpoint& other)
+{
+    if (other.width != width || other.height != height || other.key != key) {
+        std::cerr << "Checkpoints of different scenes or resolutions cannot be merged\n";
+        return false;
+    }
+    bool overlap = false;
+    uint32_t samples = maxSamples(), otherSamples = other.maxSamples();
+    for (size_t p = 0; p < sum.size(); ++p) {
+        overlap |= count[p] > 0 && other.count[p] > 0;
+        add((int)p, other.sum[p], other.count[p]);
+    }
+    // the same seed and sample indices draw the same streams, the merged pixels gain nothing
+    if (overlap && other.seed == seed && firstSample < other.firstSample + otherSamples &&
+        other.firstSample < firstSample + samples)
+        std::cerr << "Warning: merged checkpoints share seed " << seed
+                  << " and sample indices, their samples are duplicates\n";
+    firstSample = std::min(firstSample, other.firstSample);
+    return true;
+}
+
+uint64_t Checkpoint::sceneKey(const Scene& scene)
+{
+    Hasher hasher;
+    hasher.add(scene.width);
+    hasher.add(scene.height);
+    hasher.add(scene.fov);
+    hasher.add(scene.RussianRoulette);
+    hasher.add(scene.rouletteDepth);
+    hasher.add(scene.maxDepth);
+    hasher.add(scene.useMIS);
+    hasher.add(scene.backgroundColor.x);
+    hasher.add(scene.backgroundColor.y);
+    hasher.add(scene.backgroundColor.z);
+    for (Object* object : scene.get_objects()) {
+        Bounds3 bounds = object->getBounds();
+        hasher.add(object->getPrimitiveCount());
+        hasher.add(object->getArea());
+        hasher.add(bounds.pMin.x); hasher.add(bounds.pMin.y); hasher.add(bounds.pMin.z);
+        hasher.add(bounds.pMax.x); hasher.add(bounds.pMax.y); hasher.add(bounds.pMax.z);
+        // an edited material changes the image as much as moved geometry
+        for (Material* m : object->getMaterials()) {
+            hasher.add(m->m_type);
+            hasher.add(m->m_emission.x); hasher.add(m->m_emission.y); hasher.add(m->m_emission.z);
+            hasher.add(m->Kd.x); hasher.add(m->Kd.y); hasher.add(m->Kd.z);
+            hasher.add(m->Ks.x); hasher.add(m->Ks.y); hasher.add(m->Ks.z);
+            hasher.add(m->ior);
+            hasher.add(m->roughness);
+            hasher.add(m->importanceSampling);
+        }
+    }
+    return hasher.h;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef RAYTRACING_CHECKPOINT_H
+#define RAYTRACING_CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Vector.hpp"
+
+class Scene;
+
+// Float radiance sums and sample counts of every pixel, the lossless state of
+// a progressive render. Saved as a small header followed by the raw RGB sums
+// and the counts of the smallest rectangle holding every sampled pixel
+// (native byte order, so files only move between machines of the same
+// endianness), so a partial of a crop window stays small. Two checkpoints of
+// the same scene merge by adding both arrays, which pastes disjoint regions
+// side by side and averages shared pixels weighted by their sample counts;
+// that is exact as long as the runs drew different samples (another seed or
+// a disjoint range of sample indices).
+class Checkpoint
+{
+public:
+    Checkpoint() = default;
+    Checkpoint(int width, int height)
+        : width(width), height(height), sum(width * height, Vector3f(0.0f)), count(width * height, 0) {}
+
+    void add(int pixel, const Vector3f& radianceSum, uint32_t samples)
+    {
+        sum[pixel] += radianceSum;
+        count[pixel] += samples;
+    }
+    Vector3f color(int pixel) const { return count[pixel] ? sum[pixel] / (float)count[pixel] : Vector3f(0.0f); }
+    std::vector<Vector3f> image() const;
+    uint32_t maxSamples() const;
+    // pixels without any sample, e.g. outside every merged crop window
+    int emptyPixels() const;
+
+    // false (with a message on stderr) if the file is unreadable, not a
+    // checkpoint or from another version
+    bool load(const std::string& filename);
+    // written to filename.tmp and renamed over filename, a crash mid-write
+    // leaves the previous checkpoint intact
+    bool save(const std::string& filename) const;
+    // false if the two differ in size or scene
+    bool merge(const Checkpoint& other);
+
+    // hash of what decides the image: resolution, camera, integrator options,
+    // the objects' primitive counts, areas and bounds and their materials
+    static uint64_t sceneKey(const Scene& scene);
+
+    int width = 0, height = 0;
+    uint64_t key = 0;
+    uint64_t seed = 0;
+    uint64_t firstSample = 0;   // sample index the pixels' streams started at
+    std::vector<Vector3f> sum;
+    std::vector<uint32_t> count;
+};
+
+#endif //RAYTRACING_CHECKPOINT_H
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include "Denoiser.hpp"
+
+namespace {
+
+float luminance(const Vector3f& c) { return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z; }
+
+// per channel albedo to divide out, channels that are (nearly) black are kept
+Vector3f demodulation(const Vector3f& albedo)
+{
+    const float minAlbedo = 1e-3f;
+    return Vector3f(albedo.x > minAlbedo ? albedo.x : 1.0f,
+                    albedo.y > minAlbedo ? albedo.y : 1.0f,
+                    albedo.z > minAlbedo ? albedo.z : 1.0f);
+}
+
+} // namespace
+
+void Denoiser::denoise(std::vector<Vector3f>& color, const AOVBuffers& aov, ThreadPool& pool) const
+{
+    const int width = aov.width, height = aov.height, n = width * height;
+    std::vector<Vector3f> irradiance(n), filtered(n);
+    std::vector<float> variance(n), filteredVariance(n), depthGradient(n);
+
+    for (int p = 0; p < n; ++p) {
+        Vector3f a = demodulation(aov.albedo[p]);
+        irradiance[p] = Vector3f(color[p].x / a.x, color[p].y / a.y, color[p].z / a.z);
+    }
+
+    // initial luminance variance over the 3x3 neighbourhood, and how fast the
+    // depth changes per pixel (the depth edge stop is relative to it)
+    pool.parallelFor(height, [&](int y, int) {
+        for (int x = 0; x < width; ++x) {
+            int p = y * width + x;
+            float sum = 0, sum2 = 0, gradient = 0;
+            int count = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int qx = x + dx, qy = y + dy;
+                    if (qx < 0 || qy < 0 || qx >= width || qy >= height)
+                        continue;
+                    int q = qy * width + qx;
+                    if (aov.unfiltered(q) != aov.unfiltered(p))
+                        continue;
+                    float l = luminance(irradiance[q]);
+                    sum += l;
+                    sum2 += l * l;
+                    ++count;
+                    if (!aov.unfiltered(p) && (dx == 0) != (dy == 0))
+                        gradient = std::max(gradient, std::fabs(aov.depth[q] - aov.depth[p]));
+                }
+            }
+            float mean = sum / count;
+            variance[p] = std::max(0.0f, sum2 / count - mean * mean);
+            depthGradient[p] = gradient;
+        }
+    });
+
+    const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        const int step = 1 << iteration;
+        pool.parallelFor(height, [&](int y, int) {
+            for (int x = 0; x < width; ++x) {
+                int p = y * width + x;
+                if (aov.unfiltered(p)) {
+                    filtered[p] = irradiance[p];
+                    filteredVariance[p] = variance[p];
+                    continue;
+                }
+                const Vector3f& np = aov.normal[p];
+                float zp = aov.depth[p], lp = luminance(irradiance[p]);
+                float luminanceScale = settings.sigmaLuminance * std::sqrt(variance[p]) + 1e-6f;
+
+                Vector3f sum(0.0f);
+                float weightSum = 0, varianceSum = 0;
+                for (int dy = -2; dy <= 2; ++dy) {
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        int qx = x + dx * step, qy = y + dy * step;
+                        if (qx < 0 || qy < 0 || qx >= width || qy >= height)
+                            continue;
+                        int q = qy * width + qx;
+                        if (aov.unfiltered(q))
+                            continue;
+                        float wNormal = std::pow(std::max(0.0f, dotProduct(np, aov.normal[q])), settings.sigmaNormal);
+                        float wDepth = std::exp(-std::fabs(zp - aov.depth[q]) /
+                                                (settings.sigmaDepth * depthGradient[p] * step * std::max(std::abs(dx), std::abs(dy)) + 1e-6f));
+                        float wLuminance = std::exp(-std::fabs(lp - luminance(irradiance[q])) / luminanceScale);
+                        float weight = kernel[std::abs(dx)] * kernel[std::abs(dy)] * wNormal * wDepth * wLuminance;
+                        sum += irradiance[q] * weight;
+                        weightSum += weight;
+                        varianceSum += weight * weight * variance[q];
+                    }
+                }
+                // the center tap always has a positive weight
+                filtered[p] = sum / weightSum;
+                filteredVariance[p] = varianceSum / (weightSum * weightSum);
+            }
+        });
+        irradiance.swap(filtered);
+        variance.swap(filteredVariance);
+    }
+
+    for (int p = 0; p < n; ++p)
+        color[p] = irradiance[p] * demodulation(aov.albedo[p]);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#ifndef RAYTRACING_DENOISER_H
+#define RAYTRACING_DENOISER_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "Vector.hpp"
+#include "ThreadPool.hpp"
+
+// Auxiliary buffers written from the first hit of every pixel's camera ray.
+// Pixels whose ray escapes have zero albedo and normal and the largest depth.
+struct AOVBuffers
+{
+    int width = 0, height = 0;
+    std::vector<Vector3f> albedo, normal;
+    std::vector<float> depth;
+    std::vector<uint8_t> emissive;      // camera sees a light directly
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        albedo.assign(w * h, Vector3f(0.0f));
+        normal.assign(w * h, Vector3f(0.0f));
+        depth.assign(w * h, std::numeric_limits<float>::max());
+        emissive.assign(w * h, 0);
+    }
+    bool background(int pixel) const { return depth[pixel] == std::numeric_limits<float>::max(); }
+    // background and lights are exact already and would bleed into their surroundings
+    bool unfiltered(int pixel) const { return background(pixel) || emissive[pixel]; }
+};
+
+// Edge-avoiding a-trous wavelet filter in the style of SVGF's spatial pass
+// (Dammertz et al. 2010, Schied et al. 2017). The color is divided by the
+// albedo so textures survive, filtered with a 5x5 B3-spline kernel whose taps
+// spread out by 2^i per iteration, and each tap is weighted down across
+// normal, depth and luminance edges. The luminance edge stop is scaled by a
+// variance that starts as a 3x3 spatial estimate and is filtered alongside.
+class Denoiser
+{
+public:
+    struct Settings
+    {
+        int iterations = 5;
+        float sigmaLuminance = 4.0f;
+        float sigmaNormal = 128.0f;
+        float sigmaDepth = 1.0f;
+    };
+
+    explicit Denoiser(const Settings& settings) : settings(settings) {}
+
+    // filter color in place, the rows of every iteration run on the pool
+    void denoise(std::vector<Vector3f>& color, const AOVBuffers& aov, ThreadPool& pool) const;
+
+private:
+    Settings settings;
+};
+
+#endif //RAYTRACING_DENOISER_H
@@ -0,0 +1,346 @@
+// FastObjLoader.hpp - parallel Wavefront OBJ parser
+//
+// Replacement for objl::Loader when only the geometry is needed. The file is
+// memory mapped (read into memory on Windows), cut into one chunk per thread
+// at line boundaries, and every chunk is parsed on its own thread with
+// std::from_chars into flat arrays; the chunks are then concatenated. The
+// result is indexed: one array per attribute and, per triangle corner, an
+// index into each of them. Polygons are split into fans, o/g/usemtl/mtllib
+// and everything else besides v/vt/vn/f is skipped.
+
+#ifndef FAST_OBJ_LOADER_HPP
+#define FAST_OBJ_LOADER_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fastobj
+{
+    struct Mesh
+    {
+        std::vector<float> positions;    // x, y, z
+        std::vector<float> texcoords;    // u, v
+        std::vector<float> normals;      // x, y, z
+        // three corners per triangle; -1 where the face has no uv / normal
+        std::vector<int> positionIndices, texcoordIndices, normalIndices;
+
+        size_t numPositions() const { return positions.size() / 3; }
+        size_t numTriangles() const { return positionIndices.size() / 3; }
+    };
+
+    namespace detail
+    {
+        // read-only bytes of a whole file
+        class FileView
+        {
+        public:
+            ~FileView()
+            {
+#ifndef _WIN32
+                if (mapped)
+                    munmap(const_cast<char*>(bytes), length);
+#endif
+            }
+
+            bool open(const std::string& filename)
+            {
+#ifndef _WIN32
+                int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0)
+                    return false;
+                struct stat st;
+                bool ok = fstat(fd, &st) == 0;
+                length = ok ? (size_t)st.st_size : 0;
+                if (ok && length > 0) {
+                    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    ok = p != MAP_FAILED;
+                    if (ok) {
+                        bytes = static_cast<const char*>(p);
+                        mapped = true;
+                        madvise(p, length, MADV_SEQUENTIAL);
+                    }
+                }
+                ::close(fd);
+                return ok;
+#else
+                FILE* fp = fopen(filename.c_str(), "rb");
+                if (!fp)
+                    return false;
+                fseek(fp, 0, SEEK_END);
+                long size = ftell(fp);
+                fseek(fp, 0, SEEK_SET);
+                buffer.resize(size > 0 ? (size_t)size : 0);
+                bool ok = size >= 0 && fread(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+                fclose(fp);
+                bytes = buffer.data();
+                length = buffer.size();
+                return ok;
+#endif
+            }
+
+            const char* data() const { return bytes; }
+            size_t size() const { return length; }
+
+        private:
+            const char* bytes = nullptr;
+            size_t length = 0;
+            std::vector<char> buffer;
+            bool mapped = false;
+        };
+
+        inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        inline const char* skipBlanks(const char* p, const char* end)
+        {
+            while (p < end && isBlank(*p))
+                ++p;
+            return p;
+        }
+
+        inline const char* parseFloat(const char* p, const char* end, float& value)
+        {
+            p = skipBlanks(p, end);
+            if (p < end && *p == '+')
+                ++p;
+#if defined(__cpp_lib_to_chars) || (defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11)
+            auto result = std::from_chars(p, end, value);
+            return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+            // standard libraries without floating point from_chars
+            char token[64];
+            size_t n = 0;
+            while (p + n < end && n + 1 < sizeof(token) && !isBlank(p[n]) && p[n] != '\n')
+                token[n] = p[n], ++n;
+            token[n] = 0;
+            char* stop;
+            value = std::strtof(token, &stop);
+            return stop == token ? nullptr : p + (stop - token);
+#endif
+        }
+
+        inline const char* parseInt(const char* p, const char* end, int& value)
+        {
+            if (p < end && *p == '+')
+                ++p;
+            auto result = std::from_chars(p, end, value);
+            return result.ec == std::errc() ? result.ptr : nullptr;
+        }
+
+        // One chunk's output. A positive OBJ index is global; a negative one
+        // is relative to the vertices seen so far, which for a chunk is only
+        // known after the earlier chunks are counted, so those corners are
+        // stored relative to the chunk start and listed in `relative`.
+        struct Chunk
+        {
+            Mesh mesh;
+            std::vector<size_t> relative[3];  // corners to shift, per attribute
+        };
+
+        inline void parseChunk(const char* p, const char* end, Chunk& chunk)
+        {
+            Mesh& mesh = chunk.mesh;
+            // corners of the current face: position, texcoord, normal
+            std::vector<int> face[3];
+            std::vector<bool> faceRelative[3];
+
+            while (p < end) {
+                const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+                if (!lineEnd)
+                    lineEnd = end;
+                const char* q = skipBlanks(p, lineEnd);
+                p = lineEnd + 1;
+                if (lineEnd - q < 2)
+                    continue;
+
+                if (q[0] == 'v' && isBlank(q[1])) {
+                    float x, y, z;
+                    const char* r = parseFloat(q + 2, lineEnd, x);
+                    r = r ? parseFloat(r, lineEnd, y) : nullptr;
+                    r = r ? parseFloat(r, lineEnd, z) : nullptr;
+                    if (!r)
+                        x = y = z = 0;
+                    mesh.positions.insert(mesh.positions.end(), {x, y, z});
+                }
+                else if (q[0] == 'v' && q[1] == 't' && lineEnd - q > 2 && isBlank(q[2])) {
+                    float u = 0, v = 0;
+                    const char* r = parseFloat(q + 3, lineEnd, u);
+                    if (r)
+                        parseFloat(r, lineEnd, v);
+                    mesh.texcoords.insert(mesh.texcoords.end(), {u, v});
+                }
+                else if (q[0] == 'v' && q[1] == 'n' && lineEnd - q > 2 && isBlank(q[2])) {
+                    float x, y, z;
+                    const char* r = parseFloat(q + 3, lineEnd, x);
+                    r = r ? parseFloat(r, lineEnd, y) : nullptr;
+                    r = r ? parseFloat(r, lineEnd, z) : nullptr;
+                    if (!r)
+                        x = y = z = 0;
+                    mesh.normals.insert(mesh.normals.end(), {x, y, z});
+                }
+                else if (q[0] == 'f' && isBlank(q[1])) {
+                    const int counts[3] = {(int)mesh.positions.size() / 3, (int)mesh.texcoords.size() / 2,
+                                           (int)mesh.normals.size() / 3};
+                    for (int a = 0; a < 3; ++a) {
+                        face[a].clear();
+                        faceRelative[a].clear();
+                    }
+                    const char* r = q + 2;
+                    while (true) {
+                        r = skipBlanks(r, lineEnd);
+                        if (r >= lineEnd)
+                            break;
+                        // v, v/vt, v//vn or v/vt/vn
+                        int index[3] = {0, 0, 0};
+                        for (int a = 0; a < 3; ++a) {
+                            if (a > 0) {
+                                if (r >= lineEnd || *r != '/')
+                                    break;
+                                ++r;
+                            }
+                            if (r < lineEnd && *r != '/' && !isBlank(*r)) {
+                                const char* next = parseInt(r, lineEnd, index[a]);
+                                if (!next)
+                                    break;
+                                r = next;
+                            }
+                        }
+                        while (r < lineEnd && !isBlank(*r))
+                            ++r;
+                        if (index[0] == 0)
+                            continue;
+                        for (int a = 0; a < 3; ++a) {
+                            if (index[a] < 0) {
+                                face[a].push_back(counts[a] + index[a]);
+                                faceRelative[a].push_back(true);
+                            } else {
+                                face[a].push_back(index[a] - 1);  // -1 for a missing attribute
+                                faceRelative[a].push_back(false);
+                            }
+                        }
+                    }
+                    std::vector<int>* out[3] = {&mesh.positionIndices, &mesh.texcoordIndices, &mesh.normalIndices};
+                    for (size_t k = 2; k < face[0].size(); ++k) {
+                        const size_t corners[3] = {0, k - 1, k};
+                        for (size_t c : corners) {
+                            for (int a = 0; a < 3; ++a) {
+                                if (faceRelative[a][c])
+                                    chunk.relative[a].push_back(out[a]->size());
+                                out[a]->push_back(face[a][c]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // numThreads = 0: one per hardware thread. Returns false if the file
+    // cannot be read; indices that point outside the attribute arrays are
+    // clamped to -1 (position indices: the triangle is dropped).
+    inline bool load(const std::string& filename, Mesh& mesh, int numThreads = 0)
+    {
+        using namespace detail;
+        FileView file;
+        if (!file.open(filename))
+            return false;
+        mesh = Mesh();
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+
+        // small files are not worth a thread
+        const size_t minChunk = 1 << 16;
+        if (numThreads <= 0)
+            numThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+        numThreads = (int)std::max<size_t>(1, std::min<size_t>(numThreads, file.size() / minChunk));
+
+        // cut after a newline near every 1/numThreads of the file
+        std::vector<const char*> cuts = {begin};
+        for (int t = 1; t < numThreads; ++t) {
+            const char* c = std::max(cuts.back(), begin + file.size() * t / numThreads);
+            const char* nl = static_cast<const char*>(memchr(c, '\n', end - c));
+            cuts.push_back(nl ? nl + 1 : end);
+        }
+        cuts.push_back(end);
+
+        std::vector<Chunk> chunks(numThreads);
+        std::vector<std::thread> threads;
+        for (int t = 1; t < numThreads; ++t)
+            threads.emplace_back(parseChunk, cuts[t], cuts[t + 1], std::ref(chunks[t]));
+        parseChunk(cuts[0], cuts[1], chunks[0]);
+        for (std::thread& thread : threads)
+            thread.join();
+
+        // concatenate, shifting relative indices by the attributes of the earlier chunks
+        size_t sizes[6] = {};
+        for (const Chunk& c : chunks) {
+            sizes[0] += c.mesh.positions.size();
+            sizes[1] += c.mesh.texcoords.size();
+            sizes[2] += c.mesh.normals.size();
+            sizes[3] += c.mesh.positionIndices.size();
+        }
+        mesh.positions.reserve(sizes[0]);
+        mesh.texcoords.reserve(sizes[1]);
+        mesh.normals.reserve(sizes[2]);
+        for (auto* indices : {&mesh.positionIndices, &mesh.texcoordIndices, &mesh.normalIndices})
+            indices->reserve(sizes[3]);
+
+        for (Chunk& c : chunks) {
+            const int offsets[3] = {(int)mesh.numPositions(), (int)mesh.texcoords.size() / 2,
+                                    (int)mesh.normals.size() / 3};
+            std::vector<int>* indices[3] = {&c.mesh.positionIndices, &c.mesh.texcoordIndices, &c.mesh.normalIndices};
+            for (int a = 0; a < 3; ++a)
+                for (size_t corner : c.relative[a])
+                    (*indices[a])[corner] += offsets[a];
+            mesh.positions.insert(mesh.positions.end(), c.mesh.positions.begin(), c.mesh.positions.end());
+            mesh.texcoords.insert(mesh.texcoords.end(), c.mesh.texcoords.begin(), c.mesh.texcoords.end());
+            mesh.normals.insert(mesh.normals.end(), c.mesh.normals.begin(), c.mesh.normals.end());
+            mesh.positionIndices.insert(mesh.positionIndices.end(), indices[0]->begin(), indices[0]->end());
+            mesh.texcoordIndices.insert(mesh.texcoordIndices.end(), indices[1]->begin(), indices[1]->end());
+            mesh.normalIndices.insert(mesh.normalIndices.end(), indices[2]->begin(), indices[2]->end());
+            c.mesh = Mesh();
+        }
+
+        // validate against the final attribute counts
+        const int counts[3] = {(int)mesh.numPositions(), (int)mesh.texcoords.size() / 2, (int)mesh.normals.size() / 3};
+        size_t kept = 0;
+        for (size_t t = 0; t < mesh.numTriangles(); ++t) {
+            bool valid = true;
+            for (int k = 0; k < 3; ++k) {
+                int& p = mesh.positionIndices[3 * t + k];
+                valid = valid && p >= 0 && p < counts[0];
+                int& uv = mesh.texcoordIndices[3 * t + k];
+                int& n = mesh.normalIndices[3 * t + k];
+                if (uv >= counts[1] || uv < 0) uv = -1;
+                if (n >= counts[2] || n < 0) n = -1;
+            }
+            if (!valid)
+                continue;
+            for (int k = 0; k < 3; ++k) {
+                mesh.positionIndices[3 * kept + k] = mesh.positionIndices[3 * t + k];
+                mesh.texcoordIndices[3 * kept + k] = mesh.texcoordIndices[3 * t + k];
+                mesh.normalIndices[3 * kept + k] = mesh.normalIndices[3 * t + k];
+            }
+            ++kept;
+        }
+        for (auto* indices : {&mesh.positionIndices, &mesh.texcoordIndices, &mesh.normalIndices})
+            indices->resize(3 * kept);
+        return true;
+    }
+}
+
+#endif // FAST_OBJ_LOADER_HPP
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef RAYTRACING_FILM_H
+#define RAYTRACING_FILM_H
+
+#include <cmath>
+#include <vector>
+#include "Vector.hpp"
+
+// Per-pixel running statistics. The color mean and the luminance variance
+// are updated with Welford's algorithm, so a pixel's noise can be estimated
+// at any time without storing its samples. A pixel is only ever touched by
+// the thread that renders its tile.
+class Film
+{
+public:
+    Film(int width, int height)
+        : width(width), height(height), count(width * height, 0),
+          mean(width * height, Vector3f(0.0f)), lumMean(width * height, 0.0), lumM2(width * height, 0.0) {}
+
+    void addSample(int pixel, const Vector3f& L)
+    {
+        int n = ++count[pixel];
+        mean[pixel] += (L - mean[pixel]) / n;
+        double y = luminance(L);
+        double delta = y - lumMean[pixel];
+        lumMean[pixel] += delta / n;
+        lumM2[pixel] += delta * (y - lumMean[pixel]);
+    }
+
+    int samples(int pixel) const { return count[pixel]; }
+    const Vector3f& color(int pixel) const { return mean[pixel]; }
+
+    // half width of the 95% confidence interval of the pixel's luminance,
+    // relative to the luminance itself (floored so black pixels converge)
+    float relativeError(int pixel) const
+    {
+        int n = count[pixel];
+        if (n < 2)
+            return std::numeric_limits<float>::infinity();
+        double variance = lumM2[pixel] / (n - 1);
+        double halfWidth = 1.96 * std::sqrt(variance / n);
+        return (float)(halfWidth / std::max(lumMean[pixel], minLuminance));
+    }
+
+    static double luminance(const Vector3f& c) { return 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z; }
+
+    const int width, height;
+
+private:
+    static constexpr double minLuminance = 0.01;
+
+    std::vector<int> count;
+    std::vector<Vector3f> mean;
+    std::vector<double> lumMean, lumM2;
+};
+
+#endif //RAYTRACING_FILM_H
@@ -0,0 +1,170 @@
+#pragma once
+#ifndef RAYTRACING_INSTANCE_H
+#define RAYTRACING_INSTANCE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include "Object.hpp"
+#include "Triangle.hpp"
+#include "Matrix.hpp"
+
+// Two-level acceleration structure: a MeshTriangle loaded in object space
+// carries the bottom-level BVH and is shared by any number of Instances; the
+// scene BVH is built over the Instances (top level). Rays are moved into
+// object space at the instance boundary, so copies cost no triangles and no
+// BVH rebuilds.
+class Instance : public Object
+{
+public:
+    Instance(std::shared_ptr<MeshTriangle> mesh, Material* mt, const Matrix4f& objectToWorld)
+        : mesh(std::move(mesh)), m(mt), objectToWorld(objectToWorld),
+          worldToObject(objectToWorld.Inverse()),
+          normalToWorld(worldToObject.Transpose())
+    {
+        // world bounds from the 8 transformed corners of the object box
+        Bounds3 objectBounds = this->mesh->getBounds();
+        for (int i = 0; i < 8 && this->mesh->triangles.numTriangles() > 0; ++i) {
+            Vector3f corner(objectBounds[i & 1].x, objectBounds[(i >> 1) & 1].y, objectBounds[(i >> 2) & 1].z);
+            bounding_box = Union(bounding_box, objectToWorld * corner);
+        }
+
+        area = 0;
+        for (int i = 0; i < getPrimitiveCount(); ++i)
+            area += getPrimitiveArea(i);
+    }
+
+    // Bottom-level meshes are loaded once per OBJ file and shared
+    static std::shared_ptr<MeshTriangle> LoadMesh(const std::string& filename)
+    {
+        static std::map<std::string, std::weak_ptr<MeshTriangle>> cache;
+        std::shared_ptr<MeshTriangle> mesh = cache[filename].lock();
+        if (!mesh) {
+            mesh = std::make_shared<MeshTriangle>(filename, &blasMaterial());
+            cache[filename] = mesh;
+        }
+        return mesh;
+    }
+
+    bool intersect(const Ray& ray) override
+    {
+        float scale;
+        return mesh->intersect(toObject(ray, scale));
+    }
+
+    bool intersect(const Ray&, float&, uint32_t&) const override { return false; }
+
+    bool closestHit(const Ray& ray, HitRecord& hit) override
+    {
+        float scale;
+        Ray objectRay = toObject(ray, scale);
+        HitRecord objectHit = hit;
+        objectHit.t = hit.t * scale;
+        if (!mesh->closestHit(objectRay, objectHit))
+            return false;
+        hit = objectHit;
+        hit.t = objectHit.t / scale;
+        hit.obj = this;
+        return true;
+    }
+
+    // the mesh interpolates in object space, the position comes from the world ray
+    SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit) override
+    {
+        float scale;
+        Ray objectRay = toObject(ray, scale);
+        HitRecord objectHit = hit;
+        objectHit.t = hit.t * scale;
+        SurfaceInteraction isect = mesh->surfaceInteraction(objectRay, objectHit);
+        isect.coords = ray(hit.t);
+        isect.normal = normalize(normalToWorld.transformVector(isect.normal));
+        isect.geometricNormal = normalize(normalToWorld.transformVector(isect.geometricNormal));
+        isect.distance = hit.t;
+        isect.obj = this;
+        isect.m = m;
+        return isect;
+    }
+
+    // the packet stays coherent in object space, only the scale differs per ray
+    uint64_t closestHits(RayPacket& packet, HitRecord* hits) override
+    {
+        RayPacket objectPacket;
+        float scales[RayPacket::MaxRays];
+        for (int i = 0; i < packet.size(); ++i) {
+            Ray ray = packet.rays[i];
+            ray.t_max = packet.tMax[i];
+            objectPacket.add(toObject(ray, scales[i]));
+        }
+        uint64_t hitMask = mesh->closestHits(objectPacket, hits);
+        for (int i = 0; i < packet.size(); ++i) {
+            if (!(hitMask & (uint64_t(1) << i)))
+                continue;
+            hits[i].t = objectPacket.tMax[i] / scales[i];
+            hits[i].obj = this;
+            packet.tMax[i] = hits[i].t;
+        }
+        return hitMask;
+    }
+
+    void getSurfaceProperties(const Vector3f&, const Vector3f&, const uint32_t&,
+                              const Vector2f&, Vector3f&, Vector2f&) const override {}
+    Vector3f evalDiffuseColor(const Vector2f& st) const override { return mesh->evalDiffuseColor(st); }
+    Bounds3 getBounds() override { return bounding_box; }
+    float getArea() override { return area; }
+
+    // pdf is exact for rigid transforms and uniform scales
+    void Sample(Intersection& pos, float& pdf, Sampler& sampler) override
+    {
+        mesh->Sample(pos, pdf, sampler);
+        pos.coords = objectToWorld * pos.coords;
+        pos.normal = normalize(normalToWorld.transformVector(pos.normal));
+        pos.emit = m->getEmission();
+        pdf = 1.0f / area;
+    }
+    bool hasEmit() override { return m->hasEmission(); }
+    // the instance's material replaces the mesh's
+    std::vector<Material*> getMaterials() override { return {m}; }
+
+    int getPrimitiveCount() override { return (int)mesh->triangles.numTriangles(); }
+    float getPrimitiveArea(int i) override
+    {
+        const TriangleMesh& triangles = mesh->triangles;
+        return crossProduct(objectToWorld.transformVector(triangles.e1[i]),
+                            objectToWorld.transformVector(triangles.e2[i])).norm() * 0.5f;
+    }
+    // an affine map keeps a uniform point on a triangle uniform, so this pdf is exact
+    void SamplePrimitive(int i, Intersection& pos, float& pdf, Sampler& sampler) override
+    {
+        mesh->SamplePrimitive(i, pos, pdf, sampler);
+        pos.coords = objectToWorld * pos.coords;
+        pos.normal = normalize(normalToWorld.transformVector(pos.normal));
+        pos.emit = m->getEmission();
+        pdf = 1.0f / getPrimitiveArea(i);
+    }
+
+    std::shared_ptr<MeshTriangle> mesh;
+    Material* m;
+    Matrix4f objectToWorld, worldToObject, normalToWorld;
+    Bounds3 bounding_box;
+    float area;
+
+private:
+    // Object-space ray with a unit direction; t_object = t_world * scale
+    Ray toObject(const Ray& ray, float& scale) const
+    {
+        Vector3f dir = worldToObject.transformVector(ray.direction);
+        scale = dir.norm();
+        Ray objectRay(worldToObject * ray.origin, dir / scale);
+        if (ray.t_max < kInfinity)
+            objectRay.t_max = ray.t_max * scale;
+        return objectRay;
+    }
+
+    static Material& blasMaterial()
+    {
+        static Material material;
+        return material;
+    }
+};
+
+#endif //RAYTRACING_INSTANCE_H
@@ -4,8 +4,12 @@
 
 #ifndef RAYTRACING_INTERSECTION_H
 #define RAYTRACING_INTERSECTION_H
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include "Vector.hpp"
 #include "Material.hpp"
+#include "Ray.hpp"
 class Object;
 class Sphere;
 
@@ -15,17 +19,63 @@ struct Intersection
         happened=false;
         coords=Vector3f();
         normal=Vector3f();
+        geometricNormal=Vector3f();
         distance= std::numeric_limits<double>::max();
         obj =nullptr;
         m=nullptr;
+        primId=0;
     }
     bool happened;
     Vector3f coords;
     Vector3f tcoords;
-    Vector3f normal;
+    Vector3f normal;            // shading normal (interpolated vertex normals)
+    Vector3f geometricNormal;   // normal of the surface itself, decides which side a ray is on
     Vector3f emit;
     double distance;
     Object* obj;
     Material* m;
+    // primitive of obj that was hit (triangle index for meshes)
+    int primId;
+};
+
+// Rays leaving a surface start this far (relative to the size of the
+// coordinates) off it along the geometric normal
+const float RayEpsilon = 1e-4f;
+
+// Origin of a ray leaving the surface point p in direction dir: pushed to the
+// side of the surface dir points to, so the ray can't hit the surface it
+// starts on again at t ~ 0
+inline Vector3f offsetRayOrigin(const Vector3f& p, const Vector3f& ng, const Vector3f& dir)
+{
+    float scale = std::max(1.0f, std::max(std::fabs(p.x), std::max(std::fabs(p.y), std::fabs(p.z))));
+    Vector3f offset = ng * (RayEpsilon * scale);
+    return dotProduct(dir, ng) > 0 ? p + offset : p - offset;
+}
+
+// With shading normals a direction can be above the shading normal and below
+// the surface; wo and wi are only a valid reflection if the geometric normal
+// puts them on the same side
+inline bool sameSide(const Vector3f& ng, const Vector3f& wo, const Vector3f& wi)
+{
+    return dotProduct(ng, wo) * dotProduct(ng, wi) > 0;
+}
+
+// The full shading record of a hit. Traversal only tracks a HitRecord; this
+// is built once for the closest hit (Object::surfaceInteraction).
+using SurfaceInteraction = Intersection;
+
+// Compact closest-hit record carried through BVH traversal: the distance, the
+// object and its primitive, and the barycentrics on that primitive.
+struct HitRecord
+{
+    HitRecord() {}
+    // searches [0, ray.t_max)
+    explicit HitRecord(const Ray& ray) : t((float)std::min(ray.t_max, (double)std::numeric_limits<float>::max())) {}
+    bool happened() const { return primId >= 0; }
+
+    float t = std::numeric_limits<float>::max();
+    Object* obj = nullptr;
+    int primId = -1;
+    float u = 0, v = 0;
 };
 #endif //RAYTRACING_INTERSECTION_H
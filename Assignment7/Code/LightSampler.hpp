@@ -0,0 +1,114 @@
+#pragma once
+#ifndef RAYTRACING_LIGHTSAMPLER_H
+#define RAYTRACING_LIGHTSAMPLER_H
+
+#include <unordered_map>
+#include <vector>
+#include "Object.hpp"
+#include "Sampler.hpp"
+
+// Alias table (Walker / Vose) over every emissive primitive of the scene,
+// weighted by emitted power x area. Built once with the BVH; picking a light
+// primitive then costs one uniform and O(1) work however many emitters there are.
+class LightSampler
+{
+public:
+    void build(const std::vector<Object*>& objects)
+    {
+        entries.clear();
+        firstEntry.clear();
+        for (Object* object : objects) {
+            if (!object->hasEmit())
+                continue;
+            // emitted radiance is read off a sample point of each primitive;
+            // every primitive gets an entry so pdf() can index them directly
+            Sampler sampler;
+            int first = (int)entries.size();
+            double objectWeight = 0;
+            for (int i = 0; i < object->getPrimitiveCount(); ++i) {
+                Intersection probe;
+                float probePdf;
+                object->SamplePrimitive(i, probe, probePdf, sampler);
+                float power = (probe.emit.x + probe.emit.y + probe.emit.z) / 3.0f;
+                float area = object->getPrimitiveArea(i);
+                entries.push_back({object, i, std::max(0.0f, power * area), area, 0, 0});
+                objectWeight += entries.back().pmf;
+            }
+            if (objectWeight > 0)
+                firstEntry[object] = first;
+            else
+                entries.resize(first);
+        }
+
+        double total = 0;
+        for (const Entry& e : entries)
+            total += e.pmf;
+        for (Entry& e : entries)
+            e.pmf = (float)(e.pmf / total);
+
+        // Vose: pair every under-full bucket with an over-full one
+        int n = (int)entries.size();
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; ++i) {
+            scaled[i] = entries[i].pmf * (double)n;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(), l = large.back();
+            small.pop_back();
+            entries[s].threshold = (float)scaled[s];
+            entries[s].alias = l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // leftovers are full up to rounding
+        for (int i : small) entries[i].threshold = 1.0f, entries[i].alias = i;
+        for (int i : large) entries[i].threshold = 1.0f, entries[i].alias = i;
+    }
+
+    // area pdf of sample() generating a point on primitive i of object
+    float pdf(const Object* object, int primitive) const
+    {
+        auto it = firstEntry.find(object);
+        if (it == firstEntry.end())
+            return 0;
+        const Entry& e = entries[it->second + primitive];
+        return e.area > 0 ? e.pmf / e.area : 0;
+    }
+
+    bool empty() const { return entries.empty(); }
+    size_t size() const { return entries.size(); }
+
+    // point on a light, pdf with respect to area over all lights
+    void sample(Intersection& pos, float& pdf, Sampler& sampler) const
+    {
+        pdf = 0;
+        if (entries.empty())
+            return;
+        // one uniform picks the bucket and, rescaled, the side of the split
+        float u = sampler.get1D() * entries.size();
+        int bucket = std::min((int)u, (int)entries.size() - 1);
+        const Entry& e = entries[u - bucket < entries[bucket].threshold ? bucket : entries[bucket].alias];
+        float primitivePdf;
+        e.object->SamplePrimitive(e.primitive, pos, primitivePdf, sampler);
+        pdf = e.pmf * primitivePdf;
+    }
+
+private:
+    struct Entry {
+        Object* object;
+        int primitive;
+        float pmf;        // probability of picking this primitive
+        float area;
+        float threshold;  // alias table: keep the bucket below this, else take alias
+        int alias;
+    };
+    std::vector<Entry> entries;
+    std::unordered_map<const Object*, int> firstEntry;
+};
+
+#endif //RAYTRACING_LIGHTSAMPLER_H
@@ -11,8 +11,8 @@ enum MaterialType { DIFFUSE , MICROFACET };
 
 class Material{
 private:
-    Vector3f toWorld(const Vector3f &a, const Vector3f &N){
-        Vector3f B, C;
+    // orthonormal frame (B, C, N) around the normal
+    static void buildBasis(const Vector3f &N, Vector3f &B, Vector3f &C){
         if (std::fabs(N.x) > std::fabs(N.y)){
             float invLen = 1.0f / std::sqrt(N.x * N.x + N.z * N.z);
             C = Vector3f(N.z * invLen, 0.0f, -N.x *invLen);
@@ -22,8 +22,53 @@ private:
             C = Vector3f(0.0f, N.z * invLen, -N.y *invLen);
         }
         B = crossProduct(C, N);
+    }
+    Vector3f toWorld(const Vector3f &a, const Vector3f &N){
+        Vector3f B, C;
+        buildBasis(N, B, C);
         return a.x * B + a.y * C + a.z * N;
     }
+    Vector3f toLocal(const Vector3f &a, const Vector3f &N){
+        Vector3f B, C;
+        buildBasis(N, B, C);
+        return Vector3f(dotProduct(a, B), dotProduct(a, C), dotProduct(a, N));
+    }
+
+    // cosine-weighted hemisphere, pdf = cos(theta) / PI
+    static Vector3f sampleCosineHemisphere(float u1, float u2){
+        float r = std::sqrt(u1), phi = 2 * M_PI * u2;
+        return Vector3f(r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - u1)));
+    }
+
+    // Visible normals of GGX seen from Ve (local frame, z up), Heitz 2018:
+    // "Sampling the GGX Distribution of Visible Normals"
+    static Vector3f sampleGGXVNDF(const Vector3f &Ve, float alpha, float u1, float u2){
+        Vector3f Vh = normalize(Vector3f(alpha * Ve.x, alpha * Ve.y, Ve.z));
+        float lensq = Vh.x * Vh.x + Vh.y * Vh.y;
+        Vector3f T1 = lensq > 0 ? Vector3f(-Vh.y, Vh.x, 0) / std::sqrt(lensq) : Vector3f(1, 0, 0);
+        Vector3f T2 = crossProduct(Vh, T1);
+        float r = std::sqrt(u1), phi = 2 * M_PI * u2;
+        float t1 = r * std::cos(phi), t2 = r * std::sin(phi);
+        float s = 0.5f * (1.0f + Vh.z);
+        t2 = (1.0f - s) * std::sqrt(std::max(0.0f, 1.0f - t1 * t1)) + s * t2;
+        Vector3f Nh = t1 * T1 + t2 * T2 + std::sqrt(std::max(0.0f, 1.0f - t1 * t1 - t2 * t2)) * Vh;
+        return normalize(Vector3f(alpha * Nh.x, alpha * Nh.y, std::max(0.0f, Nh.z)));
+    }
+
+    // exact Smith masking of GGX, the one the visible normal distribution uses
+    static float SmithG1(float alpha, float NdotV){
+        float a2 = alpha * alpha;
+        return 2 * NdotV / (NdotV + std::sqrt(a2 + (1 - a2) * NdotV * NdotV));
+    }
+
+    // MICROFACET: probability of sampling the specular lobe instead of the diffuse one
+    float specularProbability(float NdotV) const {
+        if (NdotV <= 0) return 0;
+        float spec = (Ks.x + Ks.y + Ks.z) / 3, diff = (Kd.x + Kd.y + Kd.z) / 3;
+        if (spec <= 0) return 0;
+        if (diff <= 0) return 1;
+        return clamp(0.1f, 0.9f, spec / (spec + diff));
+    }
 
     // TODO MISSION
     Vector3f getMiddleVector(const Vector3f &a, const Vector3f &b){
@@ -95,9 +140,11 @@ private:
 public:
     MaterialType m_type;
     Vector3f m_emission;
-    float ior;
+    float ior = 1.0f;
     Vector3f Kd, Ks;
-    float roughness;
+    float roughness = 0.0f;
+    // false: uniform hemisphere directions for every material (the old sampler)
+    bool importanceSampling = true;
 
     inline Material(MaterialType t = DIFFUSE, Vector3f e = Vector3f(0.0f));
     inline Material(MaterialType t, Vector3f e,Vector3f Kd);
@@ -106,9 +153,12 @@ public:
     inline Vector3f getColorAt(double u, double v);
     inline Vector3f getEmission();
     inline bool hasEmission();
+    // reflectance used as the albedo AOV
+    inline Vector3f getAlbedo();
 
-    // sample a ray by Material properties
-    inline Vector3f sample(const Vector3f &wi, const Vector3f &N);
+    // sample a ray by Material properties; wi is the incoming ray direction
+    // (pointing at the surface), the result points away from it
+    inline Vector3f sample(const Vector3f &wi, const Vector3f &N, Sampler &sampler);
     // given a ray, calculate the PdF of this ray
     inline float pdf(const Vector3f &wi, const Vector3f &wo, const Vector3f &N);
     // given a ray, calculate the contribution of this ray
@@ -140,46 +190,80 @@ bool Material::hasEmission() {
     else return false;
 }
 
+Vector3f Material::getAlbedo() {
+    if (m_type == MICROFACET)
+        return Vector3f(std::min(1.0f, Kd.x + Ks.x), std::min(1.0f, Kd.y + Ks.y), std::min(1.0f, Kd.z + Ks.z));
+    return Kd;
+}
+
 Vector3f Material::getColorAt(double u, double v) {
     return Vector3f();
 }
 
 // TODO MISSION
-Vector3f Material::sample(const Vector3f &wi, const Vector3f &N){
+Vector3f Material::sample(const Vector3f &wi, const Vector3f &N, Sampler &sampler){
+    if (!importanceSampling) {
+        // uniform sample on the hemisphere
+        float x_1 = sampler.get1D(), x_2 = sampler.get1D();
+        float z = std::fabs(1.0f - 2.0f * x_1);
+        float r = std::sqrt(1.0f - z * z), phi = 2 * M_PI * x_2;
+        Vector3f localRay(r*std::cos(phi), r*std::sin(phi), z);
+        return toWorld(localRay, N);
+    }
     switch(m_type){
         case DIFFUSE:
+        {
+            float x_1 = sampler.get1D(), x_2 = sampler.get1D();
+            return toWorld(sampleCosineHemisphere(x_1, x_2), N);
+        }
         case MICROFACET:
         {
-            // uniform sample on the hemisphere
-            float x_1 = get_random_float(), x_2 = get_random_float();
-            float z = std::fabs(1.0f - 2.0f * x_1);
-            float r = std::sqrt(1.0f - z * z), phi = 2 * M_PI * x_2;
-            Vector3f localRay(r*std::cos(phi), r*std::sin(phi), z);
-            return toWorld(localRay, N);
-            
-            break;
+            // one lobe per sample: GGX visible normals or the diffuse cosine lobe
+            Vector3f V = -wi;
+            float pSpecular = specularProbability(dotProduct(N, V));
+            float x_0 = sampler.get1D(), x_1 = sampler.get1D(), x_2 = sampler.get1D();
+            if (x_0 >= pSpecular)
+                return toWorld(sampleCosineHemisphere(x_1, x_2), N);
+            Vector3f H = toWorld(sampleGGXVNDF(toLocal(V, N), roughness, x_1, x_2), N);
+            return 2.0f * dotProduct(V, H) * H - V;
         }
     }
+    return N;
 }
 
 // TODO MISSION
 float Material::pdf(const Vector3f &wi, const Vector3f &wo, const Vector3f &N){
+    float NdotL = dotProduct(wo, N);
+    if (NdotL <= 0.0f)
+        return 0.0f;
+    if (!importanceSampling) {
+        // uniform sample probability 1 / (2 * PI)
+        return 0.5f / M_PI;
+    }
     switch(m_type){
         case DIFFUSE:
+            return NdotL / M_PI;
         case MICROFACET:
         {
-            // uniform sample probability 1 / (2 * PI)
-            if (dotProduct(wo, N) > 0.0f)
-                return 0.5f / M_PI;
-            else
-                return 0.0f;
-            break;
+            Vector3f V = -wi;
+            float NdotV = dotProduct(N, V);
+            float pSpecular = specularProbability(NdotV);
+            float pdf = (1.0f - pSpecular) * NdotL / M_PI;
+            if (pSpecular > 0) {
+                // VNDF: D_V(H) = G1(V) D(H) (V.H) / (N.V), reflected: / (4 V.H)
+                Vector3f H = getMiddleVector(V, wo);
+                float NdotH = dotProduct(N, H);
+                if (NdotH > 0)
+                    pdf += pSpecular * SmithG1(roughness, NdotV) * D_GGX(roughness, NdotH) / (4 * NdotV);
+            }
+            return pdf;
         }
     }
+    return 0.0f;
 }
 
 // TODO MISSION
-Vector3f Material::eval(const Vector3f &V, const Vector3f &L, const Vector3f &N){
+Vector3f Material::eval(const Vector3f &wi, const Vector3f &L, const Vector3f &N){
     switch(m_type){
         case DIFFUSE:
         {
@@ -195,12 +279,14 @@ Vector3f Material::eval(const Vector3f &V, const Vector3f &L, const Vector3f &N)
         }
         case MICROFACET:
         {
+            // V points back to the viewer, the incoming direction wi points at the surface
+            Vector3f V = -wi;
             float NdotL = dotProduct(N, L);
-            if(NdotL > 0.0f)
+            float NdotV = dotProduct(N, V);
+            if(NdotL > 0.0f && NdotV > 0.0f)
             {
                 Vector3f H = getMiddleVector(L, V);
-            
-                float NdotV = dotProduct(N, V);
+
                 float NdotH = dotProduct(N, H);
                 float HdotV = dotProduct(H, V);
 
@@ -218,6 +304,7 @@ Vector3f Material::eval(const Vector3f &V, const Vector3f &L, const Vector3f &N)
             break;
         }
     }
+    return Vector3f(0.0f);
 }
 
 #endif //RAYTRACING_MATERIAL_H
@@ -13,6 +13,9 @@ public:
                 m[i][j] = 0;
     }
 
+    // the 16 entries, row by row
+    const float* data() const { return &m[0][0]; }
+
     static Matrix4f Identity() {
         Matrix4f mat;
         for (int i = 0; i < 4; i++)
@@ -50,6 +53,55 @@ public:
         return Vector3f(x, y, z);
     }
 
+    // 只作用于方向向量(w=0), 不含平移
+    Vector3f transformVector(const Vector3f &vec) const {
+        return Vector3f(vec.x * m[0][0] + vec.y * m[0][1] + vec.z * m[0][2],
+                        vec.x * m[1][0] + vec.y * m[1][1] + vec.z * m[1][2],
+                        vec.x * m[2][0] + vec.y * m[2][1] + vec.z * m[2][2]);
+    }
+
+    Matrix4f Transpose() const {
+        Matrix4f result;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                result.m[i][j] = m[j][i];
+        return result;
+    }
+
+    // 高斯-约当消元求逆(部分主元)
+    Matrix4f Inverse() const {
+        float a[4][8];
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++) {
+                a[i][j] = m[i][j];
+                a[i][j + 4] = (i == j) ? 1.0f : 0.0f;
+            }
+        for (int col = 0; col < 4; col++) {
+            int pivot = col;
+            for (int row = col + 1; row < 4; row++)
+                if (std::fabs(a[row][col]) > std::fabs(a[pivot][col]))
+                    pivot = row;
+            if (pivot != col)
+                for (int j = 0; j < 8; j++)
+                    std::swap(a[col][j], a[pivot][j]);
+            float inv = 1.0f / a[col][col];
+            for (int j = 0; j < 8; j++)
+                a[col][j] *= inv;
+            for (int row = 0; row < 4; row++) {
+                if (row == col)
+                    continue;
+                float f = a[row][col];
+                for (int j = 0; j < 8; j++)
+                    a[row][j] -= f * a[col][j];
+            }
+        }
+        Matrix4f result;
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                result.m[i][j] = a[i][j + 4];
+        return result;
+    }
+
     // 创建平移矩阵
     static Matrix4f Translate(float tx, float ty, float tz) {
         Matrix4f mat = Identity();
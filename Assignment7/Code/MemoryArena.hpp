@@ -0,0 +1,85 @@
+#pragma once
+#ifndef RAYTRACING_MEMORYARENA_H
+#define RAYTRACING_MEMORYARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic allocator: objects are bumped out of large blocks and never freed
+// one by one, all memory goes away with the arena. Allocation order is memory
+// order, so a tree built depth first ends up depth first in memory. Not thread
+// safe: a parallel builder gives every task its own arena and adopt()s it once
+// the task has finished.
+class MemoryArena
+{
+public:
+    explicit MemoryArena(size_t blockSize = 256 * 1024) : blockSize(blockSize) {}
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+    MemoryArena(MemoryArena&&) = default;
+    MemoryArena& operator=(MemoryArena&&) = default;
+
+    // only for trivially destructible types, destructors are never run
+    template <typename T, typename... Args>
+    T* alloc(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "MemoryArena never runs destructors");
+        void* p = allocBytes(sizeof(T), alignof(T));
+        return new (p) T(std::forward<Args>(args)...);
+    }
+
+    void* allocBytes(size_t bytes, size_t align)
+    {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (blocks.empty() || offset + bytes > capacity) {
+            capacity = std::max(bytes + align, blockSize);
+            blocks.emplace_back(new uint8_t[capacity]);
+            reserved += capacity;
+            current = blocks.back().get();
+            offset = 0;     // new[] aligns for any fundamental type
+        }
+        used = offset + bytes;
+        allocated += bytes;
+        return current + offset;
+    }
+
+    // take over the blocks of another arena, e.g. of a finished build task
+    void adopt(MemoryArena&& other)
+    {
+        // bumping continues in our current block, the adopted ones only need freeing
+        for (auto& block : other.blocks)
+            blocks.push_back(std::move(block));
+        reserved += other.reserved;
+        allocated += other.allocated;
+        other.blocks.clear();
+        other.current = nullptr;
+        other.capacity = other.used = other.reserved = other.allocated = 0;
+    }
+
+    void reset()
+    {
+        blocks.clear();
+        current = nullptr;
+        capacity = used = reserved = allocated = 0;
+    }
+
+    // bytes handed out / bytes held in blocks
+    size_t bytesAllocated() const { return allocated; }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    size_t blockSize;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    uint8_t* current = nullptr;
+    size_t capacity = 0, used = 0;
+    size_t reserved = 0, allocated = 0;
+};
+
+#endif //RAYTRACING_MEMORYARENA_H
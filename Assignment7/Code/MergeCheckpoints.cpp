@@ -0,0 +1,42 @@
+// Combines checkpoints of the same scene into one checkpoint and its image:
+// partials of different crop windows or tile ranges are pasted together, and
+// where inputs share pixels (different --seed or --sample-offset runs) the
+// pixel is the sample-weighted mean of them.
+//
+// usage: MergeCheckpoints out.ckpt out.ppm in1.ckpt in2.ckpt ...
+#include <cstdio>
+#include <iostream>
+#include <utility>
+#include "Checkpoint.hpp"
+#include "Renderer.hpp"
+
+int main(int argc, char** argv)
+{
+    if (argc < 4) {
+        std::cerr << "usage: " << argv[0] << " out.ckpt out.ppm in1.ckpt [in2.ckpt ...]\n";
+        return 1;
+    }
+
+    Checkpoint merged;
+    for (int a = 3; a < argc; ++a) {
+        Checkpoint input;
+        if (!input.load(argv[a])) {
+            std::cerr << "Cannot read " << argv[a] << "\n";
+            return 1;
+        }
+        printf("%s: %dx%d, seed %llu, up to %u spp\n", argv[a], input.width, input.height,
+               (unsigned long long)input.seed, input.maxSamples());
+        if (a == 3)
+            merged = std::move(input);
+        else if (!merged.merge(input))
+            return 1;
+    }
+
+    if (!merged.save(argv[1]))
+        return 1;
+    writePPM(argv[2], merged.image(), merged.width, merged.height);
+    printf("Merged %d checkpoints, up to %u spp\n", argc - 3, merged.maxSamples());
+    if (int empty = merged.emptyPixels())
+        printf("Warning: %d pixels are not covered by any partial\n", empty);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "MeshCache.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    length = (size_t)st.st_size;
+    if (length > 0) {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        bytes = static_cast<const uint8_t*>(p);
+        mapped = true;
+    }
+    ::close(fd);
+    return true;
+#else
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buffer.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size >= 0 && fread(buffer.data(), 1, buffer.size(), fp) == buffer.size();
+    fclose(fp);
+    if (!ok)
+        return false;
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+    mapped = false;
+    bytes = nullptr;
+    length = 0;
+    buffer.clear();
+}
+
+namespace {
+
+const char Magic[8] = {'R', 'T', 'M', 'E', 'S', 'H', 0, 0};
+const uint32_t Version = 2;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeSize;          // sizeof(LinearBVHNode) of the writer
+    uint64_t sourceHash;
+    uint32_t numPositions, numTriangles, numNodes;
+    uint32_t numNormals, numTexcoords, pad;     // 0 or numPositions
+    float bounds[6];
+};
+
+uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t h = 0xcbf29ce484222325ull)
+{
+    for (size_t i = 0; i < size; ++i) {
+        h ^= data[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// the sections in file order, each padded to 8 bytes
+struct Section
+{
+    const void* src;
+    void* dst;
+    size_t bytes;
+};
+
+size_t padded(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+} // namespace
+
+uint64_t MeshCache::hashFile(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename) || file.size() == 0)
+        return 0;
+    return fnv1a(file.data(), file.size());
+}
+
+std::string MeshCache::path(const std::string& objFile, const Matrix4f& modelMatrix, int maxPrimsInNode,
+                            BVHAccel::SplitMethod splitMethod, bool fastObjLoader)
+{
+    uint64_t h = fnv1a(reinterpret_cast<const uint8_t*>(modelMatrix.data()), 16 * sizeof(float));
+    h = fnv1a(reinterpret_cast<const uint8_t*>(&maxPrimsInNode), sizeof(maxPrimsInNode), h);
+    h = fnv1a(reinterpret_cast<const uint8_t*>(&splitMethod), sizeof(splitMethod), h);
+    // the two OBJ loaders weld vertices differently
+    uint8_t loader = fastObjLoader ? 1 : 0;
+    h = fnv1a(&loader, sizeof(loader), h);
+    char name[32];
+    snprintf(name, sizeof(name), ".%016llx.meshcache", (unsigned long long)h);
+    return objFile + name;
+}
+
+bool MeshCache::load(const std::string& cacheFile, uint64_t sourceHash, TriangleMesh& mesh,
+                     std::vector<LinearBVHNode>& nodes, Bounds3& bounds)
+{
+    MappedFile file;
+    if (!file.open(cacheFile) || file.size() < sizeof(Header))
+        return false;
+    Header header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+        header.nodeSize != sizeof(LinearBVHNode) || header.sourceHash != sourceHash ||
+        (header.numNormals != 0 && header.numNormals != header.numPositions) ||
+        (header.numTexcoords != 0 && header.numTexcoords != header.numPositions))
+        return false;
+
+    // decoded on the side: a truncated file leaves mesh (and its materials) untouched
+    TriangleMesh loaded;
+    std::vector<LinearBVHNode> loadedNodes(header.numNodes);
+    loaded.positions.resize(header.numPositions);
+    loaded.normals.resize(header.numNormals);
+    loaded.texcoords.resize(header.numTexcoords);
+    loaded.indices.resize(3 * (size_t)header.numTriangles);
+    loaded.e1.resize(header.numTriangles);
+    loaded.e2.resize(header.numTriangles);
+    loaded.materialIds.resize(header.numTriangles);
+    const Section sections[] = {
+        {nullptr, loaded.positions.data(), loaded.positions.size() * sizeof(Vector3f)},
+        {nullptr, loaded.normals.data(), loaded.normals.size() * sizeof(Vector3f)},
+        {nullptr, loaded.texcoords.data(), loaded.texcoords.size() * sizeof(Vector2f)},
+        {nullptr, loaded.indices.data(), loaded.indices.size() * sizeof(uint32_t)},
+        {nullptr, loaded.e1.data(), loaded.e1.size() * sizeof(Vector3f)},
+        {nullptr, loaded.e2.data(), loaded.e2.size() * sizeof(Vector3f)},
+        {nullptr, loaded.materialIds.data(), loaded.materialIds.size() * sizeof(uint16_t)},
+        {nullptr, loadedNodes.data(), loadedNodes.size() * sizeof(LinearBVHNode)},
+    };
+
+    size_t offset = sizeof(Header);
+    for (const Section& s : sections) {
+        if (offset + s.bytes > file.size()) {
+            std::cerr << cacheFile << " is truncated\n";
+            return false;
+        }
+        if (s.bytes > 0)
+            memcpy(s.dst, file.data() + offset, s.bytes);
+        offset += padded(s.bytes);
+    }
+    loaded.materials = std::move(mesh.materials);
+    mesh = std::move(loaded);
+    nodes = std::move(loadedNodes);
+    bounds = Bounds3(Vector3f(header.bounds[0], header.bounds[1], header.bounds[2]),
+                     Vector3f(header.bounds[3], header.bounds[4], header.bounds[5]));
+    return true;
+}
+
+bool MeshCache::save(const std::string& cacheFile, uint64_t sourceHash, const TriangleMesh& mesh,
+                     const std::vector<LinearBVHNode>& nodes, const Bounds3& bounds)
+{
+    Header header;
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.nodeSize = sizeof(LinearBVHNode);
+    header.sourceHash = sourceHash;
+    header.numPositions = (uint32_t)mesh.positions.size();
+    header.numTriangles = (uint32_t)mesh.numTriangles();
+    header.numNodes = (uint32_t)nodes.size();
+    header.numNormals = (uint32_t)mesh.normals.size();
+    header.numTexcoords = (uint32_t)mesh.texcoords.size();
+    header.pad = 0;
+    const float b[6] = {bounds.pMin.x, bounds.pMin.y, bounds.pMin.z, bounds.pMax.x, bounds.pMax.y, bounds.pMax.z};
+    memcpy(header.bounds, b, sizeof(b));
+    const Section sections[] = {
+        {mesh.positions.data(), nullptr, mesh.positions.size() * sizeof(Vector3f)},
+        {mesh.normals.data(), nullptr, mesh.normals.size() * sizeof(Vector3f)},
+        {mesh.texcoords.data(), nullptr, mesh.texcoords.size() * sizeof(Vector2f)},
+        {mesh.indices.data(), nullptr, mesh.indices.size() * sizeof(uint32_t)},
+        {mesh.e1.data(), nullptr, mesh.e1.size() * sizeof(Vector3f)},
+        {mesh.e2.data(), nullptr, mesh.e2.size() * sizeof(Vector3f)},
+        {mesh.materialIds.data(), nullptr, mesh.materialIds.size() * sizeof(uint16_t)},
+        {nodes.data(), nullptr, nodes.size() * sizeof(LinearBVHNode)},
+    };
+
+    // written to a temporary and renamed, so a reader never maps a half-written cache
+    std::string tmp = cacheFile + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (!fp)
+        return false;
+    const char zeros[8] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (const Section& s : sections) {
+        // an empty section (no normals, no uvs) may have no buffer at all
+        if (s.bytes == 0)
+            continue;
+        ok = ok && fwrite(s.src, 1, s.bytes, fp) == s.bytes;
+        ok = ok && fwrite(zeros, 1, padded(s.bytes) - s.bytes, fp) == padded(s.bytes) - s.bytes;
+    }
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), cacheFile.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
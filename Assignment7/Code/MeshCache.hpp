@@ -0,0 +1,58 @@
+#pragma once
+#ifndef RAYTRACING_MESHCACHE_H
+#define RAYTRACING_MESHCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BVH.hpp"
+#include "Matrix.hpp"
+#include "TriangleMesh.hpp"
+
+// Read-only view of a whole file: mmap on POSIX, read into memory elsewhere
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    std::vector<uint8_t> buffer;   // fallback storage when the file is not mapped
+    bool mapped = false;
+};
+
+// Binary cache of a loaded MeshTriangle: the transformed (welded) vertex and index
+// buffers, the per-triangle edges and material ids and the flattened BVH, all
+// in leaf order. The file sits next to the OBJ as
+// <obj>.<hash of transform and build options>.meshcache; its header holds a
+// hash of the OBJ's bytes, so editing the OBJ rebuilds it. Loading maps the
+// file and copies each buffer in one piece, nothing is parsed per triangle.
+namespace MeshCache
+{
+    // set to false to always parse and build
+    inline bool enabled = true;
+
+    // FNV-1a of the file contents, 0 if it cannot be read
+    uint64_t hashFile(const std::string& filename);
+    // cache file next to the OBJ, keyed by everything that changes its contents
+    std::string path(const std::string& objFile, const Matrix4f& modelMatrix, int maxPrimsInNode,
+                     BVHAccel::SplitMethod splitMethod, bool fastObjLoader);
+
+    // false if the file is missing, of another version or built from another source
+    bool load(const std::string& cacheFile, uint64_t sourceHash, TriangleMesh& mesh,
+              std::vector<LinearBVHNode>& nodes, Bounds3& bounds);
+    bool save(const std::string& cacheFile, uint64_t sourceHash, const TriangleMesh& mesh,
+              const std::vector<LinearBVHNode>& nodes, const Bounds3& bounds);
+}
+
+#endif //RAYTRACING_MESHCACHE_H
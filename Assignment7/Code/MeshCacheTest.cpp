@@ -0,0 +1,85 @@
+// Regression test for the mesh cache: a cache file cut short (a crash while
+// copying it, a full disk) must fall back to parsing the OBJ and leave a mesh
+// that still renders. Works on copies of the box and light models next to the
+// build, so no cache file is left in the source tree.
+//
+// usage: MeshCacheTest <models directory>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include "Scene.hpp"
+#include "Triangle.hpp"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: MeshCacheTest <models directory>\n");
+        return 1;
+    }
+    std::string models = argv[1];
+    std::string obj = "mesh_cache_test.obj", lightObj = "mesh_cache_test_light.obj";
+    fs::copy_file(models + "/tallbox.obj", obj, fs::copy_options::overwrite_existing);
+    fs::copy_file(models + "/light.obj", lightObj, fs::copy_options::overwrite_existing);
+    auto cachePath = [](const std::string& file) {
+        return MeshCache::path(file, Matrix4f::Identity(), 4, BVHAccel::SplitMethod::SAH, MeshTriangle::fastObjLoader);
+    };
+    std::string cacheFile = cachePath(obj), lightCacheFile = cachePath(lightObj);
+    fs::remove(cacheFile);
+    fs::remove(lightCacheFile);
+
+    Material white(DIFFUSE, Vector3f(0.0f), Vector3f(0.725f, 0.71f, 0.68f));
+    Material emitter(DIFFUSE, Vector3f(20.0f), Vector3f(0.65f));
+    size_t numTriangles;
+    {
+        MeshTriangle first(obj, &white);
+        numTriangles = first.triangles.numTriangles();
+    }
+    if (!fs::exists(cacheFile)) {
+        fprintf(stderr, "FAIL: no cache written at %s\n", cacheFile.c_str());
+        return 1;
+    }
+    fs::resize_file(cacheFile, fs::file_size(cacheFile) / 2);
+
+    int failures = 0;
+    {
+        MeshTriangle box(obj, &white);
+        MeshTriangle light(lightObj, &emitter);
+        if (box.triangles.numTriangles() != numTriangles || box.triangles.materials.size() != 1) {
+            fprintf(stderr, "FAIL: reloaded %zu triangles with %zu materials, expected %zu with 1\n",
+                    box.triangles.numTriangles(), box.triangles.materials.size(), numTriangles);
+            ++failures;
+        }
+
+        // a few camera rays through the Cornell box view, every one shaded
+        Scene scene(16, 16);
+        scene.Add(&box);
+        scene.Add(&light);
+        scene.buildBVH();
+        Sampler sampler(1);
+        int hits = 0;
+        for (int j = 0; j < scene.height; ++j) {
+            for (int i = 0; i < scene.width; ++i) {
+                Vector3f dir = normalize(Vector3f(0.7f * (1 - 2 * (i + 0.5f) / scene.width),
+                                                  0.7f * (1 - 2 * (j + 0.5f) / scene.height), 1));
+                Ray ray(Vector3f(278, 273, -800), dir);
+                hits += scene.intersect(ray).happened;
+                sampler.startPixelSample(j * scene.width + i, 0);
+                Vector3f L = scene.castRay(ray, 0, sampler);
+                if (!std::isfinite(L.x) || !std::isfinite(L.y) || !std::isfinite(L.z))
+                    ++failures;
+            }
+        }
+        if (hits == 0) {
+            fprintf(stderr, "FAIL: the reloaded mesh is not hit\n");
+            ++failures;
+        }
+    }
+
+    for (const std::string& file : {obj, cacheFile, lightObj, lightCacheFile})
+        fs::remove(file);
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+// OBJ parse throughput: objl::Loader against fastobj with one and with all
+// hardware threads. Each file is parsed repeatedly for at least 0.3 s per
+// parser; the triangle counts and the sum of all corner positions are checked
+// against objl.
+//
+// usage: ObjParseBenchmark [file.obj ...]   (default: the bundled models)
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OBJ_Loader.hpp"
+#include "FastObjLoader.hpp"
+
+namespace {
+
+struct Result {
+    double seconds;     // per parse
+    size_t triangles;
+    double checksum;
+};
+
+Result measure(const std::function<void(Result&)>& parse)
+{
+    Result r{};
+    int runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (runs == 0 || elapsed < 0.3) {
+        parse(r);
+        ++runs;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    r.seconds = elapsed / runs;
+    return r;
+}
+
+Result parseObjl(const std::string& file)
+{
+    return measure([&](Result& r) {
+        objl::Loader loader;
+        loader.LoadFile(file);
+        r.triangles = 0;
+        r.checksum = 0;
+        for (const objl::Mesh& mesh : loader.LoadedMeshes) {
+            for (size_t i = 0; i + 2 < mesh.Vertices.size(); i += 3) {
+                ++r.triangles;
+                for (int k = 0; k < 3; ++k)
+                    r.checksum += mesh.Vertices[i + k].Position.X + mesh.Vertices[i + k].Position.Y +
+                                  mesh.Vertices[i + k].Position.Z;
+            }
+        }
+    });
+}
+
+Result parseFast(const std::string& file, int threads)
+{
+    return measure([&](Result& r) {
+        fastobj::Mesh mesh;
+        fastobj::load(file, mesh, threads);
+        r.triangles = mesh.numTriangles();
+        r.checksum = 0;
+        for (int p : mesh.positionIndices)
+            r.checksum += mesh.positions[3 * p] + mesh.positions[3 * p + 1] + mesh.positions[3 * p + 2];
+    });
+}
+
+long fileSize(const std::string& file)
+{
+    FILE* fp = fopen(file.c_str(), "rb");
+    if (!fp)
+        return -1;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> files;
+    for (int a = 1; a < argc; ++a)
+        files.push_back(argv[a]);
+    if (files.empty())
+        files = {"../models/HanabiBomb.obj", "../models/bunny.obj", "../models/tallbox.obj",
+                 "../../../Assignment3/Code/models/spot/spot_triangulated_good.obj"};
+
+    int hardwareThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+    printf("%-28s %9s %10s %14s %14s %14s  %s\n", "file", "KB", "triangles", "objl MB/s", "fastobj 1t",
+           (std::string("fastobj ") + std::to_string(hardwareThreads) + "t").c_str(), "check");
+    for (const std::string& file : files) {
+        long size = fileSize(file);
+        if (size < 0) {
+            printf("%-28s missing\n", file.c_str());
+            continue;
+        }
+        Result objl = parseObjl(file);
+        Result single = parseFast(file, 1);
+        Result parallel = parseFast(file, hardwareThreads);
+        double mb = size / 1e6;
+        bool same = single.triangles == objl.triangles && parallel.triangles == objl.triangles &&
+                    std::fabs(single.checksum - objl.checksum) <= 1e-6 * (1 + std::fabs(objl.checksum)) &&
+                    parallel.checksum == single.checksum;
+        std::string name = file.substr(file.find_last_of('/') + 1);
+        printf("%-28s %9.1f %10zu %14.1f %14.1f %14.1f  %s\n", name.c_str(), size / 1024.0, objl.triangles,
+               mb / objl.seconds, mb / single.seconds, mb / parallel.seconds, same ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
@@ -5,26 +5,65 @@
 #ifndef RAYTRACING_OBJECT_H
 #define RAYTRACING_OBJECT_H
 
+#include <vector>
 #include "Vector.hpp"
 #include "global.hpp"
 #include "Bounds3.hpp"
 #include "Ray.hpp"
 #include "Intersection.hpp"
+#include "RayPacket.hpp"
 
 class Object
 {
 public:
     Object() {}
     virtual ~Object() {}
+    // any-hit occlusion test over [0, ray.t_max), no hit attributes computed
     virtual bool intersect(const Ray& ray) = 0;
     virtual bool intersect(const Ray& ray, float &, uint32_t &) const = 0;
-    virtual Intersection getIntersection(Ray _ray) = 0;
+    // Closest hit in [0, hit.t): on a closer hit, updates hit (t, obj = this,
+    // primitive and barycentrics) and returns true. No surface attributes are
+    // computed here, see surfaceInteraction().
+    virtual bool closestHit(const Ray& ray, HitRecord& hit) = 0;
+    // position, shading and geometric normal, uv and material at a hit found by closestHit
+    virtual SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit) = 0;
+    // closestHit and surfaceInteraction in one go
+    Intersection getIntersection(const Ray& ray)
+    {
+        HitRecord hit(ray);
+        return closestHit(ray, hit) ? surfaceInteraction(ray, hit) : Intersection();
+    }
+    // Closest hits for a packet: hits[i] and packet.tMax[i] are only written
+    // when ray i finds something closer than tMax[i]. Returns the mask of
+    // rays that were updated. The default just loops over the rays.
+    virtual uint64_t closestHits(RayPacket& packet, HitRecord* hits)
+    {
+        uint64_t hitMask = 0;
+        for (int i = 0; i < packet.size(); ++i) {
+            HitRecord hit = hits[i];
+            hit.t = packet.tMax[i];
+            if (closestHit(packet.rays[i], hit)) {
+                hits[i] = hit;
+                packet.tMax[i] = hit.t;
+                hitMask |= uint64_t(1) << i;
+            }
+        }
+        return hitMask;
+    }
     virtual void getSurfaceProperties(const Vector3f &, const Vector3f &, const uint32_t &, const Vector2f &, Vector3f &, Vector2f &) const = 0;
     virtual Vector3f evalDiffuseColor(const Vector2f &) const =0;
     virtual Bounds3 getBounds()=0;
     virtual float getArea()=0;
-    virtual void Sample(Intersection &pos, float &pdf)=0;
+    virtual void Sample(Intersection &pos, float &pdf, Sampler &sampler)=0;
     virtual bool hasEmit()=0;
+    // every material the object shades with
+    virtual std::vector<Material*> getMaterials()=0;
+    // Emitters seen as a set of primitives (the triangles of a mesh) for the
+    // scene light table; single-primitive objects keep the defaults.
+    virtual int getPrimitiveCount() { return 1; }
+    virtual float getPrimitiveArea(int /*i*/) { return getArea(); }
+    // uniform point on primitive i, pdf with respect to its area
+    virtual void SamplePrimitive(int /*i*/, Intersection &pos, float &pdf, Sampler &sampler) { Sample(pos, pdf, sampler); }
 };
 
 
@@ -0,0 +1,126 @@
+// Ray tracing throughput of the mesh BVH on the bundled models: build time,
+// closest-hit and any-hit Mrays/s for coherent, random and incoherent rays in
+// each node layout, and the bare triangle and sphere kernels. Single threaded,
+// fixed seed; every number is the distribution over `trials` timed runs. The
+// same benchmark exists for Assignment5 (brute force) and Assignment6 (the
+// original BVH), so their JSON reports compare directly.
+//
+// usage: RayBenchmark [out.json=ray_benchmark.json] [rays=65536] [trials=11] [file.obj ...]
+//        (default: bunny, spot and HanabiBomb, run from the build directory)
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BVH.hpp"
+#include "RayBenchmark.hpp"
+#include "Sphere.hpp"
+
+namespace {
+
+const uint64_t Seed = 1;
+
+std::vector<Ray> toRays(const raybench::RaySet& set)
+{
+    std::vector<Ray> rays;
+    rays.reserve(set.rays.size());
+    for (const raybench::Ray& r : set.rays)
+        rays.emplace_back(Vector3f(r.o[0], r.o[1], r.o[2]), Vector3f(r.d[0], r.d[1], r.d[2]));
+    return rays;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string output = argc > 1 ? argv[1] : "ray_benchmark.json";
+    size_t numRays = argc > 2 ? (size_t)std::atol(argv[2]) : 65536;
+    int trials = argc > 3 ? std::atoi(argv[3]) : 11;
+    std::vector<std::string> files;
+    for (int a = 4; a < argc; ++a)
+        files.push_back(argv[a]);
+    if (files.empty())
+        files = {"../models/bunny.obj", "../../../Assignment3/Code/models/spot/spot_triangulated_good.obj",
+                 "../models/HanabiBomb.obj"};
+
+    BVHAccel::printStats = false;
+    Material material;
+    raybench::Report report("Assignment7", Seed, numRays, trials);
+    for (const std::string& file : files) {
+        raybench::Model model;
+        if (!raybench::loadModel(file, model)) {
+            fprintf(stderr, "Cannot load %s\n", file.c_str());
+            continue;
+        }
+        TriangleMesh base;
+        base.materials.push_back(&material);
+        for (size_t i = 0; i < model.positions.size(); i += 3)
+            base.positions.emplace_back(model.positions[i], model.positions[i + 1], model.positions[i + 2]);
+        for (size_t t = 0; t < model.numTriangles(); ++t)
+            base.addTriangle(model.indices[3 * t], model.indices[3 * t + 1], model.indices[3 * t + 2], 0);
+        std::vector<raybench::RaySet> sets = raybench::makeRaySets(model, numRays, Seed);
+
+        const BVHAccel::NodeLayout layouts[] = {BVHAccel::NodeLayout::BINARY, BVHAccel::NodeLayout::BVH4,
+                                                BVHAccel::NodeLayout::BVH8};
+        for (BVHAccel::NodeLayout layout : layouts) {
+            // the build reorders its mesh, so every trial starts from a copy
+            std::unique_ptr<TriangleMesh> mesh;
+            std::unique_ptr<BVHAccel> bvh;
+            std::vector<double> buildMs;
+            for (int t = 0; t < trials; ++t) {
+                auto nextMesh = std::make_unique<TriangleMesh>(base);
+                bvh.reset();
+                buildMs.push_back(1e3 * raybench::seconds([&] {
+                    bvh = std::make_unique<BVHAccel>(nextMesh.get(), 1, BVHAccel::SplitMethod::SAH, layout);
+                }));
+                mesh = std::move(nextMesh);
+            }
+            std::string variant = layout == BVHAccel::NodeLayout::BINARY ? "binary"
+                : std::string(layout == BVHAccel::NodeLayout::BVH4 ? "bvh4-" : "bvh8-") + bvh->wideNodes.isaName();
+            report.add({model.name, variant, "build", "-", "ms", raybench::summarize(buildMs),
+                        (uint64_t)bvh->nodes.size()});
+
+            for (const raybench::RaySet& set : sets) {
+                std::vector<Ray> rays = toRays(set);
+                uint64_t hits = 0;
+                std::vector<double> closest = raybench::throughput(trials, rays.size(), [&] {
+                    hits = 0;
+                    for (const Ray& ray : rays)
+                        hits += bvh->Intersect(ray).happened;
+                });
+                report.add({model.name, variant, "closest_hit", set.name, "Mrays/s", raybench::summarize(closest), hits});
+                std::vector<double> any = raybench::throughput(trials, rays.size(), [&] {
+                    hits = 0;
+                    for (const Ray& ray : rays)
+                        hits += bvh->IntersectP(ray);
+                });
+                report.add({model.name, variant, "any_hit", set.name, "Mrays/s", raybench::summarize(any), hits});
+            }
+        }
+
+        // kernels: ray i against triangle i % n, the random rays against a sphere around the model
+        raybench::RaySet aimed = raybench::makeKernelRays(model, numRays, Seed);
+        std::vector<Ray> rays = toRays(aimed);
+        uint64_t hits = 0;
+        std::vector<double> triangle = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            int n = (int)base.numTriangles();
+            for (size_t i = 0; i < rays.size(); ++i) {
+                float tMax = kInfinity, u, v;
+                int primId = -1;
+                hits += base.intersect(rays[i], (int)(i % n), 1, tMax, primId, u, v);
+            }
+        });
+        report.add({model.name, "kernel", "triangle", aimed.name, "Mtests/s", raybench::summarize(triangle), hits});
+        rays = toRays(sets[1]);
+        Vector3f lo(model.lo[0], model.lo[1], model.lo[2]), hi(model.hi[0], model.hi[1], model.hi[2]);
+        Sphere sphere((lo + hi) * 0.5f, (hi - lo).norm() * 0.25f, &material);
+        std::vector<double> sphereRate = raybench::throughput(trials, rays.size(), [&] {
+            hits = 0;
+            for (const Ray& ray : rays)
+                hits += sphere.intersect(ray);
+        });
+        report.add({model.name, "kernel", "sphere", "random", "Mtests/s", raybench::summarize(sphereRate), hits});
+    }
+    return report.write(output) ? 0 : 1;
+}
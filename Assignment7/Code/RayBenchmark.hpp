@@ -0,0 +1,277 @@
+#pragma once
+#ifndef RAYTRACING_RAYBENCHMARK_H
+#define RAYTRACING_RAYBENCHMARK_H
+
+// Shared part of the RayBenchmark executables (Assignment5 and 6 include it
+// from here): the bundled models as indexed triangle lists,
+// fixed-seed ray sets over them, trial timing with percentiles and the JSON
+// report. Each tracer converts the plain float data into its own types, so
+// all three run on identical geometry and rays.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "FastObjLoader.hpp"
+
+namespace raybench
+{
+    // splitmix64, identical on every platform (unlike the std distributions)
+    struct Rng
+    {
+        uint64_t state;
+        explicit Rng(uint64_t seed) : state(seed) {}
+        uint64_t nextBits()
+        {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+        // [0, 1)
+        float next() { return (nextBits() >> 40) * (1.0f / 16777216.0f); }
+    };
+
+    struct Model
+    {
+        std::string name;
+        std::vector<float> positions;       // x, y, z
+        std::vector<int> indices;           // three per triangle
+        float lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+
+        size_t numTriangles() const { return indices.size() / 3; }
+        const float* corner(size_t tri, int k) const { return &positions[3 * (size_t)indices[3 * tri + k]]; }
+    };
+
+    inline bool loadModel(const std::string& filename, Model& model)
+    {
+        fastobj::Mesh mesh;
+        if (!fastobj::load(filename, mesh) || mesh.numTriangles() == 0)
+            return false;
+        model.name = filename.substr(filename.find_last_of('/') + 1);
+        model.positions = std::move(mesh.positions);
+        model.indices = std::move(mesh.positionIndices);
+        for (int a = 0; a < 3; ++a) {
+            model.lo[a] = INFINITY;
+            model.hi[a] = -INFINITY;
+        }
+        for (size_t i = 0; i < model.positions.size(); ++i) {
+            model.lo[i % 3] = std::min(model.lo[i % 3], model.positions[i]);
+            model.hi[i % 3] = std::max(model.hi[i % 3], model.positions[i]);
+        }
+        return true;
+    }
+
+    struct Ray
+    {
+        float o[3], d[3];
+    };
+
+    struct RaySet
+    {
+        std::string name;
+        std::vector<Ray> rays;
+    };
+
+    inline void uniformSphere(Rng& rng, float d[3])
+    {
+        float z = 1 - 2 * rng.next();
+        float r = std::sqrt(std::max(0.0f, 1 - z * z));
+        float phi = 2 * (float)M_PI * rng.next();
+        d[0] = r * std::cos(phi);
+        d[1] = r * std::sin(phi);
+        d[2] = z;
+    }
+
+    // coherent: pinhole camera rays over the model in scanline order
+    // random:   origins uniform in the bounding box grown by half, directions uniform
+    // incoherent: origins on random triangles, uniform directions (secondary bounces)
+    inline std::vector<RaySet> makeRaySets(const Model& model, size_t count, uint64_t seed)
+    {
+        float center[3], extent[3];
+        for (int a = 0; a < 3; ++a) {
+            center[a] = 0.5f * (model.lo[a] + model.hi[a]);
+            extent[a] = model.hi[a] - model.lo[a];
+        }
+        float radius = 0.5f * std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+        std::vector<RaySet> sets(3);
+
+        sets[0].name = "coherent";
+        int side = std::max(1, (int)std::sqrt((double)count));
+        float eye[3] = {center[0], center[1], center[2] + 2.5f * radius};
+        for (int j = 0; j < side; ++j) {
+            for (int i = 0; i < side; ++i) {
+                // the model spans about a 2 * radius square at the center's depth
+                float target[3] = {center[0] + radius * (2 * (i + 0.5f) / side - 1),
+                                   center[1] + radius * (1 - 2 * (j + 0.5f) / side), center[2]};
+                Ray ray;
+                float len = 0;
+                for (int a = 0; a < 3; ++a) {
+                    ray.o[a] = eye[a];
+                    ray.d[a] = target[a] - eye[a];
+                    len += ray.d[a] * ray.d[a];
+                }
+                for (float& d : ray.d)
+                    d /= std::sqrt(len);
+                sets[0].rays.push_back(ray);
+            }
+        }
+
+        Rng rng(seed);
+        sets[1].name = "random";
+        sets[1].rays.resize(count);
+        for (Ray& ray : sets[1].rays) {
+            for (int a = 0; a < 3; ++a)
+                ray.o[a] = center[a] + 0.75f * extent[a] * (2 * rng.next() - 1);
+            uniformSphere(rng, ray.d);
+        }
+
+        sets[2].name = "incoherent";
+        sets[2].rays.resize(count);
+        for (Ray& ray : sets[2].rays) {
+            size_t tri = std::min((size_t)(rng.next() * model.numTriangles()), model.numTriangles() - 1);
+            float u = std::sqrt(rng.next()), v = rng.next();
+            uniformSphere(rng, ray.d);
+            for (int a = 0; a < 3; ++a) {
+                ray.o[a] = model.corner(tri, 0)[a] * (1 - u) + model.corner(tri, 1)[a] * (u * (1 - v)) +
+                           model.corner(tri, 2)[a] * (u * v);
+                // off the surface so the ray does not hit its own triangle
+                ray.o[a] += ray.d[a] * 1e-4f * radius;
+            }
+        }
+        return sets;
+    }
+
+    // kernel rays: ray i starts around the bounding box and aims at a point near
+    // triangle i % n, about half of them inside it
+    inline RaySet makeKernelRays(const Model& model, size_t count, uint64_t seed)
+    {
+        Rng rng(seed + 1);
+        RaySet set;
+        set.name = "aimed";
+        set.rays.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            Ray& ray = set.rays[i];
+            size_t tri = i % model.numTriangles();
+            float b1 = 1.4f * rng.next() - 0.2f, b2 = 1.4f * rng.next() - 0.2f;
+            float len = 0;
+            for (int a = 0; a < 3; ++a) {
+                ray.o[a] = model.lo[a] + (model.hi[a] - model.lo[a]) * (2 * rng.next() - 0.5f);
+                float target = model.corner(tri, 0)[a] * (1 - b1 - b2) + model.corner(tri, 1)[a] * b1 +
+                               model.corner(tri, 2)[a] * b2;
+                ray.d[a] = target - ray.o[a];
+                len += ray.d[a] * ray.d[a];
+            }
+            for (float& d : ray.d)
+                d /= std::sqrt(len);
+        }
+        return set;
+    }
+
+    struct Summary
+    {
+        double min = 0, p10 = 0, p50 = 0, p90 = 0, max = 0;
+    };
+
+    // linear interpolation between the closest ranks
+    inline Summary summarize(std::vector<double> values)
+    {
+        Summary s;
+        if (values.empty())
+            return s;
+        std::sort(values.begin(), values.end());
+        auto percentile = [&](double p) {
+            double x = p * (values.size() - 1);
+            size_t i = (size_t)x;
+            return i + 1 < values.size() ? values[i] + (x - i) * (values[i + 1] - values[i]) : values[i];
+        };
+        s.min = values.front();
+        s.p10 = percentile(0.1);
+        s.p50 = percentile(0.5);
+        s.p90 = percentile(0.9);
+        s.max = values.back();
+        return s;
+    }
+
+    template <typename Fn>
+    double seconds(Fn&& fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // one untimed warm-up run, then `trials` timed runs of `work` rays or tests
+    // each; returns millions per second per trial
+    template <typename Fn>
+    std::vector<double> throughput(int trials, size_t work, Fn&& run)
+    {
+        run();
+        std::vector<double> result;
+        for (int t = 0; t < trials; ++t)
+            result.push_back(work / seconds(run) * 1e-6);
+        return result;
+    }
+
+    struct Result
+    {
+        std::string model, variant, test, rays;
+        const char* unit;
+        Summary summary;
+        uint64_t check;     // hit count or similar, equal across variants
+    };
+
+    class Report
+    {
+    public:
+        Report(const char* tracer, uint64_t seed, size_t rays, int trials)
+            : tracer(tracer), seed(seed), numRays(rays), trials(trials) {}
+
+        void add(const Result& result)
+        {
+            results.push_back(result);
+            printf("%-30s %-14s %-12s %-11s %10.3f %-7s (p10 %.3f, p90 %.3f)  check %llu\n", result.model.c_str(),
+                   result.variant.c_str(), result.test.c_str(), result.rays.c_str(), result.summary.p50,
+                   result.unit, result.summary.p10, result.summary.p90, (unsigned long long)result.check);
+        }
+
+        bool write(const std::string& filename) const
+        {
+            FILE* fp = fopen(filename.c_str(), "w");
+            if (!fp) {
+                fprintf(stderr, "Cannot write %s\n", filename.c_str());
+                return false;
+            }
+#ifdef __OPTIMIZE__
+            const bool optimized = true;
+#else
+            const bool optimized = false;
+#endif
+            fprintf(fp, "{\n  \"tracer\": \"%s\",\n  \"seed\": %llu,\n  \"rays\": %zu,\n  \"trials\": %d,\n"
+                        "  \"optimized\": %s,\n  \"results\": [",
+                    tracer, (unsigned long long)seed, numRays, trials, optimized ? "true" : "false");
+            for (size_t i = 0; i < results.size(); ++i) {
+                const Result& r = results[i];
+                fprintf(fp, "%s\n    {\"model\": \"%s\", \"variant\": \"%s\", \"test\": \"%s\", \"rays\": \"%s\", "
+                            "\"unit\": \"%s\", \"min\": %.4f, \"p10\": %.4f, \"p50\": %.4f, \"p90\": %.4f, "
+                            "\"max\": %.4f, \"check\": %llu}",
+                        i ? "," : "", r.model.c_str(), r.variant.c_str(), r.test.c_str(), r.rays.c_str(), r.unit,
+                        r.summary.min, r.summary.p10, r.summary.p50, r.summary.p90, r.summary.max,
+                        (unsigned long long)r.check);
+            }
+            fprintf(fp, "\n  ]\n}\n");
+            return fclose(fp) == 0;
+        }
+
+    private:
+        const char* tracer;
+        uint64_t seed;
+        size_t numRays;
+        int trials;
+        std::vector<Result> results;
+    };
+}
+
+#endif //RAYTRACING_RAYBENCHMARK_H
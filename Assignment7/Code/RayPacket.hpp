@@ -0,0 +1,88 @@
+#pragma once
+#ifndef RAYTRACING_RAYPACKET_H
+#define RAYTRACING_RAYPACKET_H
+
+#include <cstdint>
+#include <vector>
+#include "Ray.hpp"
+#include "Bounds3.hpp"
+#include "global.hpp"
+
+// A bundle of up to 64 coherent rays (e.g. an 8x8 block of camera rays) that
+// walk the BVH together. tMax[i] is the closest hit of ray i found so far.
+struct RayPacket
+{
+    static constexpr int MaxRays = 64;
+
+    std::vector<Ray> rays;
+    float tMax[MaxRays];
+
+    RayPacket() { rays.reserve(MaxRays); }
+
+    int size() const { return (int)rays.size(); }
+
+    void add(const Ray& ray)
+    {
+        tMax[rays.size()] = (float)std::min(ray.t_max, (double)kInfinity);
+        rays.push_back(ray);
+    }
+
+    // Conservative interval bounds of the packet used to cull a whole box at
+    // once: valid only when every ray has the same direction sign per axis.
+    struct Interval
+    {
+        bool valid = false;
+        Vector3f originMin, originMax, invDirMin, invDirMax;
+        float maxT = 0;
+
+        // false only if no ray of the packet can hit the box
+        bool mayHit(const Bounds3& b) const
+        {
+            if (!valid)
+                return true;
+            float tEnter = 0, tExit = maxT;
+            for (int axis = 0; axis < 3; ++axis) {
+                float oMin = originMin[axis], oMax = originMax[axis];
+                float iMin = invDirMin[axis], iMax = invDirMax[axis];
+                bool neg = iMax < 0;
+                float nearPlane = neg ? b.pMax[axis] : b.pMin[axis];
+                float farPlane = neg ? b.pMin[axis] : b.pMax[axis];
+                // interval products [a0, a1] * [iMin, iMax]
+                float a0 = nearPlane - oMax, a1 = nearPlane - oMin;
+                float nearLo = std::min(std::min(a0 * iMin, a0 * iMax), std::min(a1 * iMin, a1 * iMax));
+                a0 = farPlane - oMax;
+                a1 = farPlane - oMin;
+                float farHi = std::max(std::max(a0 * iMin, a0 * iMax), std::max(a1 * iMin, a1 * iMax));
+                tEnter = std::max(tEnter, nearLo);
+                tExit = std::min(tExit, farHi);
+            }
+            return tEnter <= tExit;
+        }
+    };
+
+    Interval interval() const
+    {
+        Interval in;
+        if (rays.empty())
+            return in;
+        in.originMin = in.originMax = rays[0].origin;
+        in.invDirMin = in.invDirMax = rays[0].direction_inv;
+        for (int i = 0; i < size(); ++i) {
+            const Ray& r = rays[i];
+            in.originMin = Vector3f::Min(in.originMin, r.origin);
+            in.originMax = Vector3f::Max(in.originMax, r.origin);
+            in.invDirMin = Vector3f::Min(in.invDirMin, r.direction_inv);
+            in.invDirMax = Vector3f::Max(in.invDirMax, r.direction_inv);
+            in.maxT = std::max(in.maxT, tMax[i]);
+        }
+        const Vector3f& iMin = in.invDirMin;
+        const Vector3f& iMax = in.invDirMax;
+        in.valid = true;
+        for (int axis = 0; axis < 3; ++axis)
+            if (iMin[axis] < 0 && iMax[axis] >= 0)
+                in.valid = false;
+        return in;
+    }
+};
+
+#endif //RAYTRACING_RAYPACKET_H
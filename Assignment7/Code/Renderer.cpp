@@ -1,10 +1,13 @@
+#include <atomic>
+#include <chrono>
 #include <fstream>
-#include <thread>
+#include <memory>
+#include <algorithm>
 #include <vector>
-#include <mutex>
 #include <string>
 #include "Scene.hpp"
 #include "Renderer.hpp"
+#include "Film.hpp"
 
 inline float deg2rad(const float& deg) { return deg * M_PI / 180.0; }
 
@@ -38,85 +41,259 @@ void applyAntiAliasing(std::vector<Vector3f>& buffer, int width, int height) {
     
     buffer = newBuffer;
 }
+void writePPM(const std::string& filename, const std::vector<Vector3f>& buffer, int width, int height, float gamma)
+{
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (!fp) {
+        std::cerr << "Cannot write " << filename << "\n";
+        return;
+    }
+    (void)fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    for (auto i = 0; i < height * width; ++i) {
+        unsigned char color[3];
+        color[0] = (unsigned char)(255 * std::pow(clamp(0, 1, buffer[i].x), gamma));
+        color[1] = (unsigned char)(255 * std::pow(clamp(0, 1, buffer[i].y), gamma));
+        color[2] = (unsigned char)(255 * std::pow(clamp(0, 1, buffer[i].z), gamma));
+        fwrite(color, 1, 3, fp);
+    }
+    fclose(fp);
+}
+
+// black -> blue -> red -> yellow as t goes from 0 to 1
+static Vector3f heatColor(float t)
+{
+    t = clamp(0, 1, t);
+    Vector3f cold(0.0f, 0.0f, 1.0f), warm(1.0f, 0.0f, 0.0f), hot(1.0f, 1.0f, 0.0f);
+    Vector3f color = t < 0.5f ? lerp(cold, warm, t * 2) : lerp(warm, hot, t * 2 - 1);
+    return color * std::sqrt(t);
+}
+
+#ifdef RAYTRACING_STATS
+// false colour traversal cost per sample, scaled so the 99th percentile is hot
+static void writeCostImage(const std::vector<float>& pixelCost, float samples, int width, int height)
+{
+    std::vector<float> sorted(pixelCost);
+    size_t p99 = sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+    float scale = sorted[p99] > 0 ? 1.0f / sorted[p99] : 0.0f;
+    std::vector<Vector3f> heatmap(pixelCost.size());
+    for (size_t p = 0; p < pixelCost.size(); ++p)
+        heatmap[p] = heatColor(pixelCost[p] * scale);
+    printf("Traversal cost per sample: 99th percentile %.1f\n", samples > 0 ? sorted[p99] / samples : 0.0f);
+    writePPM("./Microfacet-Lambert/cost.ppm", heatmap, width, height, 1.0f);
+}
+#endif
+
+Ray Renderer::cameraRay(const Scene& scene, int i, int j) const
+{
+    float scale = tan(deg2rad(scene.fov * 0.5));
+    float imageAspectRatio = scene.width / (float)scene.height;
+    float x = (2 * (i + 0.5) / (float)scene.width - 1) * imageAspectRatio * scale;
+    float y = (1 - 2 * (j + 0.5) / (float)scene.height) * scale;
+    return Ray(eyePos, normalize(Vector3f(-x, y, 1)));
+}
+
 // TODO MISSION
 void Renderer::Render(const Scene& scene)
 {
+    if (adaptive.enabled) {
+        RenderAdaptive(scene);
+        return;
+    }
+
     std::vector<Vector3f> framebuffer(scene.width * scene.height);
-    float scale = tan(deg2rad(scene.fov * 0.5));
-    float imageAspectRatio = scene.width / (float)scene.height;
-    Vector3f eye_pos(278, 273, -800);
-    int spp = 256; // Samples per pixel
     
     // 添加多次渲染的参数
-    int num_renders = 8; // 渲染次数
+    int num_renders = numRenders; // 渲染次数
     std::cout << "SPP per render: " << spp << "\n";
     std::cout << "Number of renders: " << num_renders << "\n";
     std::cout << "Total effective SPP: " << spp * num_renders << "\n";
+
+    // 初始化累积缓冲区, 保存每个像素的辐亮度之和与样本数
+    Checkpoint accum(scene.width, scene.height);
+    accum.key = Checkpoint::sceneKey(scene);
+    accum.seed = seed;
+    // passes start after the samples already in the checkpoint
+    int first_render = 0;
+    uint64_t sample_base = sampleOffset;
+    accum.firstSample = sampleOffset;
+    if (!checkpointFile.empty()) {
+        Checkpoint saved;
+        if (saved.load(checkpointFile)) {
+            if (saved.width == scene.width && saved.height == scene.height && saved.key == accum.key) {
+                accum = saved;
+                sample_base = saved.firstSample + saved.maxSamples();
+                first_render = std::min(num_renders, (int)(saved.maxSamples() / spp));
+                std::cout << "Resuming " << checkpointFile << ": " << saved.maxSamples() << " spp, seed " << saved.seed << "\n";
+            } else {
+                std::cout << checkpointFile << " belongs to another scene, starting over\n";
+            }
+        }
+    }
     
-    // 初始化累积缓冲区，用于存储所有渲染结果的总和
-    std::vector<Vector3f> accumBuffer(scene.width * scene.height, Vector3f(0.0f));
-    
-    for (int render_idx = 0; render_idx < num_renders; render_idx++) {
+    std::vector<std::unique_ptr<WavefrontIntegrator>> wavefront;
+    if (integrator == IntegratorMode::WAVEFRONT) {
+        std::cout << "Integrator: wavefront, " << wavefrontBatchSize << " paths per thread\n";
+        for (int t = 0; t < pool.size(); ++t)
+            wavefront.emplace_back(new WavefrontIntegrator(scene, wavefrontBatchSize, accum.seed));
+    }
+
+    // 按 tile 划分任务, 每个 tile 只写自己的像素区域, 无需加锁
+    int tilesX = (scene.width + tileSize - 1) / tileSize;
+    int tilesY = (scene.height + tileSize - 1) / tileSize;
+    // the tiles of this process' region, clipped to its crop window
+    int cropX0 = std::max(region.x0, 0), cropY0 = std::max(region.y0, 0);
+    int cropX1 = region.x1 < 0 ? scene.width : std::min(region.x1, scene.width);
+    int cropY1 = region.y1 < 0 ? scene.height : std::min(region.y1, scene.height);
+    int tileEnd = region.tileEnd < 0 ? tilesX * tilesY : std::min(region.tileEnd, tilesX * tilesY);
+    auto tile_rect = [&](int tile, int& x0, int& y0, int& x1, int& y1) {
+        x0 = std::max((tile % tilesX) * tileSize, cropX0);
+        y0 = std::max((tile / tilesX) * tileSize, cropY0);
+        x1 = std::min((tile % tilesX) * tileSize + tileSize, cropX1);
+        y1 = std::min((tile / tilesX) * tileSize + tileSize, cropY1);
+        return x0 < x1 && y0 < y1;
+    };
+    std::vector<int> tiles;
+    for (int tile = std::max(region.tileBegin, 0); tile < tileEnd; ++tile) {
+        int x0, y0, x1, y1;
+        if (tile_rect(tile, x0, y0, x1, y1))
+            tiles.push_back(tile);
+    }
+    bool partial = (int)tiles.size() < tilesX * tilesY || cropX0 > 0 || cropY0 > 0 ||
+                   cropX1 < scene.width || cropY1 < scene.height;
+    if (partial) {
+        std::cout << "Region: pixels [" << cropX0 << ", " << cropX1 << ") x [" << cropY0 << ", " << cropY1
+                  << "), " << tiles.size() << " of " << tilesX * tilesY << " tiles\n";
+        if (checkpointFile.empty())
+            std::cout << "No checkpoint file, the partial result is only written as PPM\n";
+    }
+
+#ifdef RAYTRACING_STATS
+    // traversal cost (nodes visited + primitive tests) of each pixel's paths, summed over the passes
+    std::vector<float> pixelCost(scene.width * scene.height, 0.0f);
+    Stats::collect();
+#endif
+
+    auto last_save = std::chrono::steady_clock::now();
+    for (int render_idx = first_render; render_idx < num_renders; render_idx++) {
         std::cout << "Rendering pass " << (render_idx + 1) << " of " << num_renders << "...\n";
+        uint64_t pass_base = sample_base + (uint64_t)(render_idx - first_render) * spp;
         
         // 每次渲染清空当前帧缓冲区
         std::fill(framebuffer.begin(), framebuffer.end(), Vector3f(0.0f));
-        
-        int num_threads = std::thread::hardware_concurrency();
-        std::vector<std::thread> threads;
-        std::mutex mutex;
-
-        auto render_chunk = [&](int start, int end) {
-            for (int j = start; j < end; ++j) {
-                for (int i = 0; i < scene.width; ++i) {
-                    float x = (2 * (i + 0.5) / (float)scene.width - 1) * imageAspectRatio * scale;
-                    float y = (1 - 2 * (j + 0.5) / (float)scene.height) * scale;
-                    Vector3f dir = normalize(Vector3f(-x, y, 1));
-                    Vector3f pixel_color(0.0f);
-                    
-                    for (int k = 0; k < spp; k++) {
-                        pixel_color += scene.castRay(Ray(eye_pos, dir), 0) / spp;
+
+        auto primary_ray = [&](int i, int j) { return cameraRay(scene, i, j); };
+
+        auto render_tile = [&](int tile, int worker) {
+            int x0, y0, x1, y1;
+            tile_rect(tile, x0, y0, x1, y1);
+            if (integrator == IntegratorMode::WAVEFRONT) {
+                WavefrontIntegrator::CameraFn camera = primary_ray;
+#ifdef RAYTRACING_STATS
+                // the paths of a tile are traced interleaved, so its pixels share the tile's cost
+                float tileCost = 0;
+                {
+                    STAT_COST_SCOPE(tileCost);
+                    wavefront[worker]->renderTile(x0, y0, x1, y1, spp, pass_base, camera, framebuffer);
+                }
+                for (int j = y0; j < y1; ++j)
+                    for (int i = x0; i < x1; ++i)
+                        pixelCost[j * scene.width + i] += tileCost / ((x1 - x0) * (y1 - y0));
+#else
+                wavefront[worker]->renderTile(x0, y0, x1, y1, spp, pass_base, camera, framebuffer);
+#endif
+                return;
+            }
+
+            Sampler sampler(accum.seed);
+            if (!packetTracing) {
+                for (int j = y0; j < y1; ++j) {
+                    for (int i = x0; i < x1; ++i) {
+                        STAT_COST_SCOPE(pixelCost[j * scene.width + i]);
+                        Vector3f pixel_color(0.0f);
+                        for (int k = 0; k < spp; k++) {
+                            // one deterministic stream per (pixel, sample index)
+                            sampler.startPixelSample(j * scene.width + i, pass_base + k);
+                            pixel_color += scene.castRay(primary_ray(i, j), 0, sampler) / spp;
+                        }
+                        framebuffer[j * scene.width + i] = pixel_color;
                     }
-                    
-                    std::lock_guard<std::mutex> lock(mutex);
-                    framebuffer[j * scene.width + i] = pixel_color;
                 }
+                return;
             }
-        };
 
-        int chunk_size = scene.height / num_threads;
-        for (int t = 0; t < num_threads; ++t) {
-            int start = t * chunk_size;
-            int end = (t == num_threads - 1) ? scene.height : start + chunk_size;
-            threads.emplace_back(render_chunk, start, end);
-        }
+            // the camera rays do not depend on the sample, so each block is
+            // intersected once as a packet and only the shading runs spp times
+            int block = std::max(1, std::min(packetSize, 8));
+            RayPacket packet;
+            Intersection hits[RayPacket::MaxRays];
+            for (int by = y0; by < y1; by += block) {
+                for (int bx = x0; bx < x1; bx += block) {
+                    int bx1 = std::min(bx + block, x1), by1 = std::min(by + block, y1);
+                    packet.rays.clear();
+                    for (int j = by; j < by1; ++j)
+                        for (int i = bx; i < bx1; ++i)
+                            packet.add(primary_ray(i, j));
+                    std::fill(hits, hits + packet.size(), Intersection());
+                    STAT(Stats::local().cameraRays += packet.size());
+#ifdef RAYTRACING_STATS
+                    // the packet traversal is shared, every ray gets an equal part
+                    float packetCost = 0;
+                    {
+                        STAT_COST_SCOPE(packetCost);
+                        scene.intersectPacket(packet, hits);
+                    }
+                    for (int j = by; j < by1; ++j)
+                        for (int i = bx; i < bx1; ++i)
+                            pixelCost[j * scene.width + i] += packetCost / packet.size();
+#else
+                    scene.intersectPacket(packet, hits);
+#endif
 
-        for (auto& thread : threads) {
-            thread.join();
-        }
+                    int r = 0;
+                    for (int j = by; j < by1; ++j) {
+                        for (int i = bx; i < bx1; ++i, ++r) {
+                            STAT_COST_SCOPE(pixelCost[j * scene.width + i]);
+                            Vector3f pixel_color(0.0f);
+                            for (int k = 0; k < spp; k++) {
+                                sampler.startPixelSample(j * scene.width + i, pass_base + k);
+                                pixel_color += scene.shade(packet.rays[r], hits[r], 0, sampler) / spp;
+                            }
+                            framebuffer[j * scene.width + i] = pixel_color;
+                        }
+                    }
+                }
+            }
+        };
+
+        pool.parallelFor((int)tiles.size(), [&](int t, int worker) { render_tile(tiles[t], worker); });
         
         // 应用反锯齿滤波处理
         // std::vector<Vector3f> beforeBuffer = framebuffer;
         // applyAntiAliasing(framebuffer, scene.width, scene.height);
         
         // 将当前渲染结果添加到累积缓冲区
-        for (size_t i = 0; i < framebuffer.size(); ++i) 
-            accumBuffer[i] += framebuffer[i];
+        for (int tile : tiles) {
+            int x0, y0, x1, y1;
+            tile_rect(tile, x0, y0, x1, y1);
+            for (int j = y0; j < y1; ++j)
+                for (int i = x0; i < x1; ++i)
+                    accum.add(j * scene.width + i, framebuffer[j * scene.width + i] * (float)spp, spp);
+        }
+
+        bool last_pass = render_idx + 1 == num_renders;
+        if (!checkpointFile.empty() &&
+            (last_pass || std::chrono::duration<double>(std::chrono::steady_clock::now() - last_save).count() >= checkpointInterval)) {
+            if (accum.save(checkpointFile))
+                std::cout << "Checkpoint written: " << accum.maxSamples() << " spp\n";
+            last_save = std::chrono::steady_clock::now();
+        }
         
         // 保存每次的中间渲染结果
         if (num_renders > 1) 
         {
             std::string filename = "./Microfacet-Lambert/render_pass_" + std::to_string(render_idx + 1) + ".ppm";
-            FILE* fp = fopen(filename.c_str(), "wb");
-            (void)fprintf(fp, "P6\n%d %d\n255\n", scene.width, scene.height);
-            for (auto i = 0; i < scene.height * scene.width; ++i) {
-                static unsigned char color[3];
-                color[0] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].x), 0.6f));
-                color[1] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].y), 0.6f));
-                color[2] = (unsigned char)(255 * std::pow(clamp(0, 1, framebuffer[i].z), 0.6f));
-                fwrite(color, 1, 3, fp);
-            }
-            fclose(fp);
+            writePPM(filename, framebuffer, scene.width, scene.height);
             //Diffuse-WithAfter
             // filename = "./render_pass_before_" + std::to_string(render_idx + 1) + ".ppm";
             // fp = fopen(filename.c_str(), "wb");
@@ -132,19 +309,199 @@ void Renderer::Render(const Scene& scene)
         }
     }
     
-    // 计算最终的平均值
-    for (size_t i = 0; i < accumBuffer.size(); ++i) 
-        accumBuffer[i] = accumBuffer[i] / num_renders;
-
-    // 保存最终的平均帧缓冲区到文件
-    FILE* fp = fopen("./Microfacet-Lambert/binary.ppm", "wb");
-    (void)fprintf(fp, "P6\n%d %d\n255\n", scene.width, scene.height);
-    for (auto i = 0; i < scene.height * scene.width; ++i) {
-        static unsigned char color[3];
-        color[0] = (unsigned char)(255 * std::pow(clamp(0, 1, accumBuffer[i].x), 0.6f));
-        color[1] = (unsigned char)(255 * std::pow(clamp(0, 1, accumBuffer[i].y), 0.6f));
-        color[2] = (unsigned char)(255 * std::pow(clamp(0, 1, accumBuffer[i].z), 0.6f));
-        fwrite(color, 1, 3, fp);
+    if (!wavefront.empty()) {
+        WavefrontIntegrator::StageTimes times;
+        for (auto& w : wavefront)
+            times += w->times;
+        printf("Wavefront stage time (summed over threads): generate %.1f ms, extend %.1f ms, "
+               "shade %.1f ms, connect %.1f ms\n", times.generate, times.extend, times.shade, times.connect);
     }
-    fclose(fp);
-}
\ No newline at end of file
+
+    // 计算最终的平均值, 保存到文件
+    std::vector<Vector3f> image = accum.image();
+    writePPM("./Microfacet-Lambert/binary.ppm", image, scene.width, scene.height);
+#ifdef RAYTRACING_STATS
+    Stats::collect().print();
+    writeCostImage(pixelCost, (float)(spp * (num_renders - first_render)), scene.width, scene.height);
+#endif
+    // the filters need the whole frame, they run on the merged image instead
+    if (partial && (denoise || writeAOVs))
+        std::cout << "Partial render, skipping the denoiser and AOVs\n";
+    else
+        postProcess(scene, image);
+}
+
+// first hit of every pixel's camera ray, traced as packets
+void Renderer::computeAOVs(const Scene& scene, AOVBuffers& aov)
+{
+    aov.resize(scene.width, scene.height);
+    const int block = 8;
+    int blocksX = (scene.width + block - 1) / block, blocksY = (scene.height + block - 1) / block;
+    pool.parallelFor(blocksX * blocksY, [&](int b, int) {
+        int x0 = (b % blocksX) * block, y0 = (b / blocksX) * block;
+        int x1 = std::min(x0 + block, scene.width), y1 = std::min(y0 + block, scene.height);
+        RayPacket packet;
+        Intersection hits[RayPacket::MaxRays];
+        for (int j = y0; j < y1; ++j)
+            for (int i = x0; i < x1; ++i)
+                packet.add(cameraRay(scene, i, j));
+        scene.intersectPacket(packet, hits);
+        int r = 0;
+        for (int j = y0; j < y1; ++j) {
+            for (int i = x0; i < x1; ++i, ++r) {
+                if (!hits[r].happened)
+                    continue;
+                int pixel = j * scene.width + i;
+                aov.albedo[pixel] = hits[r].m->getAlbedo();
+                aov.normal[pixel] = normalize(hits[r].normal);
+                aov.depth[pixel] = (float)hits[r].distance;
+                aov.emissive[pixel] = hits[r].m->hasEmission();
+            }
+        }
+    });
+}
+
+void Renderer::postProcess(const Scene& scene, const std::vector<Vector3f>& image)
+{
+    if (!denoise && !writeAOVs)
+        return;
+    AOVBuffers aov;
+    computeAOVs(scene, aov);
+
+    if (writeAOVs) {
+        int n = scene.width * scene.height;
+        float maxDepth = 0;
+        for (int p = 0; p < n; ++p)
+            if (!aov.background(p))
+                maxDepth = std::max(maxDepth, aov.depth[p]);
+        std::vector<Vector3f> normal(n), depth(n);
+        for (int p = 0; p < n; ++p) {
+            normal[p] = aov.background(p) ? Vector3f(0.0f) : aov.normal[p] * 0.5f + Vector3f(0.5f);
+            depth[p] = Vector3f(aov.background(p) ? 0.0f : 1.0f - aov.depth[p] / maxDepth);
+        }
+        writePPM("./Microfacet-Lambert/albedo.ppm", aov.albedo, scene.width, scene.height, 1.0f);
+        writePPM("./Microfacet-Lambert/normal.ppm", normal, scene.width, scene.height, 1.0f);
+        writePPM("./Microfacet-Lambert/depth.ppm", depth, scene.width, scene.height, 1.0f);
+    }
+
+    if (denoise) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Vector3f> denoised = image;
+        Denoiser(denoiserSettings).denoise(denoised, aov, pool);
+        printf("Denoised in %.1f ms\n",
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        writePPM("./Microfacet-Lambert/binary_denoised.ppm", denoised, scene.width, scene.height);
+    }
+}
+
+void Renderer::RenderAdaptive(const Scene& scene)
+{
+    const AdaptiveSettings& settings = adaptive;
+    std::cout << "Adaptive sampling: warm-up " << settings.warmupSpp << " spp, batches of " << settings.batchSpp
+              << ", threshold " << settings.errorThreshold << ", max " << settings.maxSpp << " spp\n";
+    if (integrator == IntegratorMode::WAVEFRONT)
+        std::cout << "Adaptive sampling runs on the megakernel integrator\n";
+    if (!checkpointFile.empty())
+        std::cout << "Adaptive sampling does not write checkpoints\n";
+    if (region.x0 > 0 || region.y0 > 0 || region.x1 >= 0 || region.y1 >= 0 || region.tileBegin > 0 || region.tileEnd >= 0)
+        std::cout << "Adaptive sampling renders the whole frame\n";
+
+    Film film(scene.width, scene.height);
+#ifdef RAYTRACING_STATS
+    Stats::collect();
+#endif
+    int tilesX = (scene.width + tileSize - 1) / tileSize;
+    int tilesY = (scene.height + tileSize - 1) / tileSize;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int round = 0;; ++round) {
+        auto needsSamples = [&](int pixel) {
+            if (round == 0)
+                return true;
+            return film.samples(pixel) < settings.maxSpp && film.relativeError(pixel) > settings.errorThreshold;
+        };
+
+        std::atomic<long long> samplesTaken{0};
+        auto render_tile = [&](int tile, int) {
+            int x0 = (tile % tilesX) * tileSize, y0 = (tile / tilesX) * tileSize;
+            int x1 = std::min(x0 + tileSize, scene.width), y1 = std::min(y0 + tileSize, scene.height);
+            int block = std::max(1, std::min(packetSize, 8));
+            Sampler sampler(seed);
+            RayPacket packet;
+            Intersection hits[RayPacket::MaxRays];
+            int pixels[RayPacket::MaxRays];
+            long long taken = 0;
+            for (int by = y0; by < y1; by += block) {
+                for (int bx = x0; bx < x1; bx += block) {
+                    // only the block's unconverged pixels go into the packet
+                    packet.rays.clear();
+                    for (int j = by; j < std::min(by + block, y1); ++j)
+                        for (int i = bx; i < std::min(bx + block, x1); ++i)
+                            if (needsSamples(j * scene.width + i)) {
+                                pixels[packet.size()] = j * scene.width + i;
+                                packet.add(cameraRay(scene, i, j));
+                            }
+                    if (packet.size() == 0)
+                        continue;
+                    if (packetTracing) {
+                        std::fill(hits, hits + packet.size(), Intersection());
+                        STAT(Stats::local().cameraRays += packet.size());
+                        scene.intersectPacket(packet, hits);
+                    }
+
+                    for (int r = 0; r < packet.size(); ++r) {
+                        int pixel = pixels[r];
+                        // batches grow with the pixel's count, so rounds stay few
+                        int n = round == 0 ? settings.warmupSpp : std::max(settings.batchSpp, film.samples(pixel) / 2);
+                        n = std::max(0, std::min(n, settings.maxSpp - film.samples(pixel)));
+                        for (int k = 0; k < n; k++) {
+                            sampler.startPixelSample(pixel, film.samples(pixel));
+                            film.addSample(pixel, packetTracing ? scene.shade(packet.rays[r], hits[r], 0, sampler)
+                                                                : scene.castRay(packet.rays[r], 0, sampler));
+                        }
+                        taken += n;
+                    }
+                }
+            }
+            samplesTaken += taken;
+        };
+        pool.parallelFor(tilesX * tilesY, render_tile);
+
+        // pixels still above the threshold, and the mean error over the image
+        int active = 0;
+        double errorSum = 0;
+        for (int p = 0; p < scene.width * scene.height; ++p) {
+            float e = film.relativeError(p);
+            errorSum += std::min(e, 1.0f);
+            if (film.samples(p) < settings.maxSpp && e > settings.errorThreshold)
+                ++active;
+        }
+        double meanError = errorSum / (scene.width * scene.height);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Adaptive round %d: %lld samples, %d pixels above threshold, mean error %.4f, %.1f s\n",
+               round, (long long)samplesTaken, active, meanError, elapsed);
+
+        if (active == 0 || (settings.targetError > 0 && meanError <= settings.targetError) ||
+            (settings.timeBudget > 0 && elapsed >= settings.timeBudget))
+            break;
+    }
+
+#ifdef RAYTRACING_STATS
+    Stats::collect().print();
+#endif
+    std::vector<Vector3f> image(scene.width * scene.height);
+    long long totalSamples = 0;
+    for (int p = 0; p < scene.width * scene.height; ++p) {
+        image[p] = film.color(p);
+        totalSamples += film.samples(p);
+    }
+    printf("Average spp: %.1f\n", totalSamples / (double)(scene.width * scene.height));
+    writePPM("./Microfacet-Lambert/binary.ppm", image, scene.width, scene.height);
+    postProcess(scene, image);
+
+    // samples per pixel heatmap: black -> blue -> red -> yellow as spp grows to maxSpp
+    std::vector<Vector3f> heatmap(scene.width * scene.height);
+    for (int p = 0; p < scene.width * scene.height; ++p)
+        heatmap[p] = heatColor(film.samples(p) / (float)settings.maxSpp);
+    writePPM("./Microfacet-Lambert/spp_heatmap.ppm", heatmap, scene.width, scene.height, 1.0f);
+}
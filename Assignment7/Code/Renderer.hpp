@@ -2,6 +2,10 @@
 // Created by goksu on 2/25/20.
 //
 #include "Scene.hpp"
+#include "ThreadPool.hpp"
+#include "Wavefront.hpp"
+#include "Denoiser.hpp"
+#include "Checkpoint.hpp"
 
 #pragma once
 struct hit_payload
@@ -12,9 +16,87 @@ struct hit_payload
     Object* hit_obj;
 };
 
+// 8-bit binary PPM, each channel clamped to [0, 1] and raised to gamma
+void writePPM(const std::string& filename, const std::vector<Vector3f>& buffer, int width, int height,
+              float gamma = 0.6f);
+
 class Renderer
 {
 public:
+    // MEGAKERNEL follows one path at a time through Scene::castRay,
+    // WAVEFRONT advances batches of paths stage by stage (see Wavefront.hpp)
+    enum class IntegratorMode { MEGAKERNEL, WAVEFRONT };
+
+    explicit Renderer(int numThreads = 0) : pool(numThreads) {}
     void Render(const Scene& scene);
+    // ray from the eye through the center of pixel (i, j)
+    Ray cameraRay(const Scene& scene, int i, int j) const;
+
+    int spp = 256;          // samples per pixel of one pass
+    int numRenders = 8;     // passes, averaged into binary.ppm
+    uint64_t seed = 0;      // selects the random streams, runs that are merged need different seeds
+
+    // Progressive rendering: with a checkpoint file the float radiance sums
+    // and per-pixel sample counts are saved after every pass that ends at
+    // least checkpointInterval seconds after the last save, and after the
+    // last pass. A checkpoint of the same scene found at startup is resumed
+    // (with its seed), so only the missing passes are rendered.
+    std::string checkpointFile;
+    double checkpointInterval = 60;
+
+    // Distributed rendering: a process renders only the pixels inside the
+    // crop window [x0, x1) x [y0, y1) that lie in the tiles [tileBegin,
+    // tileEnd) (-1: up to the image edge / last tile), with sample indices
+    // starting at sampleOffset. Its checkpoint is the partial result;
+    // MergeCheckpoints pastes partials of other regions or adds those of
+    // other sample ranges.
+    struct Region
+    {
+        int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+        int tileBegin = 0, tileEnd = -1;
+    };
+    Region region;
+    uint64_t sampleOffset = 0;
+
+    int tileSize = 32;
+    // trace the camera rays of packetSize x packetSize pixel blocks as one
+    // packet (at most 8x8), and reuse each primary hit for all samples
+    bool packetTracing = true;
+    int packetSize = 8;
+    IntegratorMode integrator = IntegratorMode::MEGAKERNEL;
+    // paths in flight per thread in wavefront mode
+    int wavefrontBatchSize = 16384;
+
+    // Adaptive sampling (replaces the fixed passes when enabled): every pixel
+    // gets warmupSpp samples, then batches (at least batchSpp, growing with
+    // the pixel's count) go only to pixels whose
+    // relative 95% confidence interval is above errorThreshold. Stops when no
+    // pixel is left, the mean error reaches targetError or timeBudget seconds
+    // have passed (0 disables either), with at most maxSpp per pixel.
+    struct AdaptiveSettings
+    {
+        bool enabled = false;
+        int warmupSpp = 32;
+        int batchSpp = 32;
+        int maxSpp = 2048;
+        float errorThreshold = 0.02f;
+        float targetError = 0;
+        double timeBudget = 0;
+    };
+    AdaptiveSettings adaptive;
+
+    // Separate pass over the final image: binary_denoised.ppm is written next
+    // to binary.ppm. writeAOVs also dumps the albedo/normal/depth buffers.
+    bool denoise = false;
+    bool writeAOVs = false;
+    Denoiser::Settings denoiserSettings;
+
 private:
+    void computeAOVs(const Scene& scene, AOVBuffers& aov);
+    void postProcess(const Scene& scene, const std::vector<Vector3f>& image);
+    void RenderAdaptive(const Scene& scene);
+
+    Vector3f eyePos = Vector3f(278, 273, -800);
+    // persistent workers, reused by every render pass
+    ThreadPool pool;
 };
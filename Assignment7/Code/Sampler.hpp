@@ -0,0 +1,64 @@
+#pragma once
+#ifndef RAYTRACING_SAMPLER_H
+#define RAYTRACING_SAMPLER_H
+
+#include <cstdint>
+#include <algorithm>
+
+// PCG32 random stream (O'Neill, pcg-random.org). A Sampler is a few bytes of
+// plain state owned by one render thread; startPixelSample() selects an
+// independent, deterministic stream for every (pixel, sample) pair so renders
+// are reproducible regardless of thread scheduling.
+class Sampler
+{
+public:
+    explicit Sampler(uint64_t seed = 0) : seed(seed) { setSequence(0, 0); }
+
+    void startPixelSample(uint64_t pixelIndex, uint64_t sampleIndex)
+    {
+        setSequence(pixelIndex, mixBits(sampleIndex ^ (seed * 0x9E3779B97F4A7C15ull)));
+    }
+
+    void setSequence(uint64_t sequenceIndex, uint64_t offset)
+    {
+        state = 0u;
+        inc = (sequenceIndex << 1u) | 1u;
+        nextUInt();
+        state += offset;
+        nextUInt();
+    }
+
+    uint32_t nextUInt()
+    {
+        uint64_t oldstate = state;
+        state = oldstate * 0x5851f42d4c957f2dull + inc;
+        uint32_t xorshifted = (uint32_t)(((oldstate >> 18u) ^ oldstate) >> 27u);
+        uint32_t rot = (uint32_t)(oldstate >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    // uniform float in [0, 1)
+    float get1D()
+    {
+        return std::min(OneMinusEpsilon, nextUInt() * 0x1p-32f);
+    }
+
+    uint64_t seed;
+
+private:
+    static constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
+    static uint64_t mixBits(uint64_t v)
+    {
+        v ^= (v >> 31);
+        v *= 0x7fb5d329728ea185ull;
+        v ^= (v >> 27);
+        v *= 0x81dadef4bc2dd44dull;
+        v ^= (v >> 33);
+        return v;
+    }
+
+    uint64_t state, inc;
+};
+
+#endif //RAYTRACING_SAMPLER_H
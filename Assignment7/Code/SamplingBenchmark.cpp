@@ -0,0 +1,127 @@
+// Equal-time noise benchmark for the path tracer's sampling strategies.
+// Renders a Cornell box with a rough and a glossy microfacet box, first a
+// high-spp reference, then each strategy for the same wall time, and reports
+// the RMSE against the reference.
+//
+// usage: SamplingBenchmark [size=64] [seconds=1] [reference spp=2048]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Renderer.hpp"
+#include "Scene.hpp"
+#include "Triangle.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+struct Strategy {
+    const char* name;
+    bool importanceSampling;
+    bool mis;
+};
+
+struct Result {
+    std::vector<Vector3f> image;
+    int spp;
+    double seconds;
+};
+
+// Adds one sample per pixel per pass until the time budget (or maxSpp) is used up
+Result render(const Scene& scene, const Renderer& camera, ThreadPool& pool, uint64_t seed, double budget, int maxSpp)
+{
+    std::vector<Vector3f> sum(scene.width * scene.height, Vector3f(0.0f));
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    int spp = 0;
+    while (spp < maxSpp && (budget <= 0 || elapsed() < budget)) {
+        pool.parallelFor(scene.height, [&](int j, int) {
+            Sampler sampler(seed);
+            for (int i = 0; i < scene.width; ++i) {
+                sampler.startPixelSample(j * scene.width + i, spp);
+                sum[j * scene.width + i] += scene.castRay(camera.cameraRay(scene, i, j), 0, sampler);
+            }
+        });
+        ++spp;
+    }
+    for (Vector3f& c : sum)
+        c = c / std::max(spp, 1);
+    return {sum, spp, elapsed()};
+}
+
+double rmse(const std::vector<Vector3f>& image, const std::vector<Vector3f>& reference)
+{
+    double err = 0;
+    for (size_t i = 0; i < image.size(); ++i) {
+        Vector3f d = image[i] - reference[i];
+        err += d.x * d.x + d.y * d.y + d.z * d.z;
+    }
+    return std::sqrt(err / (3.0 * image.size()));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int size = argc > 1 ? std::atoi(argv[1]) : 64;
+    double budget = argc > 2 ? std::atof(argv[2]) : 1.0;
+    int referenceSpp = argc > 3 ? std::atoi(argv[3]) : 2048;
+
+    Scene scene(size, size);
+    Material* light = new Material(DIFFUSE, (8.0f * Vector3f(0.747f+0.058f, 0.747f+0.258f, 0.747f) + 15.6f * Vector3f(0.740f+0.287f,0.740f+0.160f,0.740f) + 18.4f *Vector3f(0.737f+0.642f,0.737f+0.159f,0.737f)),Vector3f(0.65f));
+    Material* red = new Material(DIFFUSE, Vector3f(0.0f),Vector3f(0.63f, 0.065f, 0.05f));
+    Material* green = new Material(DIFFUSE, Vector3f(0.0f),Vector3f(0.14f, 0.45f, 0.091f));
+    Material* white = new Material(DIFFUSE, Vector3f(0.0f),Vector3f(0.725f, 0.71f, 0.68f));
+    Material* yellow_rubber = new Material(MICROFACET, Vector3f(0.0f), 1.5f, Vector3f(0.6f, 0.4f, 0.2f),
+                                           Vector3f(0.05f, 0.05f, 0.05f), 0.8f);
+    Material* glossy = new Material(MICROFACET, Vector3f(0.0f), 1.5f, Vector3f(0.1f, 0.1f, 0.3f),
+                                    Vector3f(0.8f, 0.8f, 0.8f), 0.2f);
+    std::vector<Material*> materials = {light, red, green, white, yellow_rubber, glossy};
+
+    MeshTriangle light_("../models/light.obj", light);
+    MeshTriangle left("../models/left.obj", red);
+    MeshTriangle right("../models/right.obj", green);
+    MeshTriangle floor("../models/floor.obj", white);
+    MeshTriangle top("../models/top.obj", white);
+    MeshTriangle back("../models/back.obj", white);
+    MeshTriangle shortbox("../models/shortbox.obj", glossy);
+    MeshTriangle tallbox("../models/tallbox.obj", yellow_rubber);
+    for (Object* object : std::vector<Object*>{&light_, &left, &right, &floor, &top, &back, &shortbox, &tallbox})
+        scene.Add(object);
+    scene.buildBVH();
+
+    ThreadPool pool;
+    // only for its camera rays, the benchmark drives its own passes
+    Renderer camera(1);
+    auto configure = [&](const Strategy& s) {
+        for (Material* m : materials)
+            m->importanceSampling = s.importanceSampling;
+        scene.useMIS = s.mis;
+    };
+
+    const Strategy reference = {"reference", true, true};
+    const Strategy strategies[] = {
+        {"uniform", false, false},
+        {"bsdf importance", true, false},
+        {"bsdf importance + MIS", true, true},
+    };
+
+    configure(reference);
+    printf("Reference: %dx%d, %d spp...\n", size, size, referenceSpp);
+    Result ref = render(scene, camera, pool, 1000, 0, referenceSpp);
+    printf("  %.2f s\n\n", ref.seconds);
+
+    printf("Equal time: %.1f s per strategy, %d threads\n", budget, pool.size());
+    printf("%-24s %8s %10s %12s\n", "strategy", "spp", "RMSE", "rel. MSE");
+    double baseline = 0;
+    for (const Strategy& s : strategies) {
+        configure(s);
+        Result r = render(scene, camera, pool, 1, budget, 1 << 30);
+        double e = rmse(r.image, ref.image);
+        if (baseline == 0)
+            baseline = e;
+        printf("%-24s %8d %10.5f %12.3f\n", s.name, r.spp, e, (e * e) / (baseline * baseline));
+    }
+    return 0;
+}
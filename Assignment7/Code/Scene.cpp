@@ -1,9 +1,10 @@
 #include "Scene.hpp"
-#include <random>
 
-void Scene::buildBVH() {
+void Scene::buildBVH(BVHAccel::NodeLayout layout, int maxPrimsInNode) {
     printf(" - Generating BVH...\n\n");
-    this->bvh = new BVHAccel(objects, 1, BVHAccel::SplitMethod::SAH);
+    delete this->bvh;
+    this->bvh = new BVHAccel(objects, maxPrimsInNode, BVHAccel::SplitMethod::SAH, layout);
+    lightSampler.build(objects);
 }
 
 Intersection Scene::intersect(const Ray &ray) const
@@ -11,24 +12,19 @@ Intersection Scene::intersect(const Ray &ray) const
     return this->bvh->Intersect(ray);
 }
 
-void Scene::sampleLight(Intersection &pos, float &pdf) const
+bool Scene::intersectP(const Ray &ray) const
 {
-    float emit_area_sum = 0;
-    for (uint32_t k = 0; k < objects.size(); ++k) 
-        if (objects[k]->hasEmit())
-            emit_area_sum += objects[k]->getArea();
+    return this->bvh->IntersectP(ray);
+}
 
-    float p = get_random_float() * emit_area_sum;
-    emit_area_sum = 0;
-    for (uint32_t k = 0; k < objects.size(); ++k) {
-        if (objects[k]->hasEmit()){
-            emit_area_sum += objects[k]->getArea();
-            if (p <= emit_area_sum){
-                objects[k]->Sample(pos, pdf);
-                break;
-            }
-        }
-    }
+uint64_t Scene::intersectPacket(RayPacket &packet, Intersection *hits) const
+{
+    return this->bvh->IntersectPacket(packet, hits);
+}
+
+void Scene::sampleLight(Intersection &pos, float &pdf, Sampler &sampler) const
+{
+    lightSampler.sample(pos, pdf, sampler);
 }
 
 bool Scene::trace(
@@ -53,61 +49,117 @@ bool Scene::trace(
 
 // TODO MISSION
 // Implementation of Path Tracing
-Vector3f Scene::castRay(const Ray &ray, int depth) const
+Vector3f Scene::castRay(const Ray &ray, int depth, Sampler &sampler) const
 {
     //求交
-    Intersection intersection = intersect(ray);
-
-    if (!intersection.happened)
-        return backgroundColor;
-    if(intersection.m->hasEmission())
-        return intersection.m->getEmission();
+    STAT(++(depth == 0 ? Stats::local().cameraRays : Stats::local().indirectRays));
+    return shade(ray, intersect(ray), depth, sampler);
+}
 
-    intersection.normal = normalize(intersection.normal);
+// One bounce per iteration: `throughput` is the product of the BSDF weights
+// along the path so far, every light contribution is scaled by it.
+Vector3f Scene::shade(const Ray &cameraRay, Intersection intersection, int depth, Sampler &sampler) const
+{
+    Vector3f radiance(0.0f), throughput(1.0f);
+    Ray ray = cameraRay;
+    float bsdfPdf = 0;      // pdf of the BSDF sample that found `intersection`
+    for (;; ++depth) {
+        // path lengths count the surfaces hit, the light included
+        if (!intersection.happened) {
+            STAT(Stats::local().addPath(depth));
+            if (depth == 0)
+                radiance += backgroundColor;
+            break;
+        }
+        if (intersection.m->hasEmission()) {
+            STAT(Stats::local().addPath(depth + 1));
+            // the light hit by a BSDF sample: weighted against the light sample of the previous bounce
+            if (depth == 0)
+                radiance += intersection.m->getEmission();
+            else if (useMIS)
+                radiance += throughput * intersection.m->getEmission() *
+                            powerHeuristic(bsdfPdf, lightPdf(intersection, ray.origin));
+            break;
+        }
 
-    // 对光源采样
-    float pdfLight = 0; // 概率密度
-    Intersection lightSamplePos;
-    sampleLight(lightSamplePos, pdfLight);
-    lightSamplePos.normal = normalize(lightSamplePos.normal);
+        intersection.normal = normalize(intersection.normal);
+        const Vector3f& P = intersection.coords;
+        const Vector3f& N = intersection.normal;
+        const Vector3f& Ng = intersection.geometricNormal;
+        Vector3f wo = -ray.direction;
+        Material* m = intersection.m;
 
-    Vector3f lightDir = lightSamplePos.coords - intersection.coords;
-    Ray lightRay(intersection.coords, normalize(lightDir));
-    Intersection lightIntersection = intersect(lightRay);
+        // 对光源采样
+        float pdfLight = 0; // 概率密度
+        Intersection lightSamplePos;
+        sampleLight(lightSamplePos, pdfLight, sampler);
+        lightSamplePos.normal = normalize(lightSamplePos.normal);
 
-    // 前置判断遮挡 避免边界噪音
-    if (lightIntersection.happened && lightIntersection.m->hasEmission()) 
-    {
+        Vector3f lightDir = lightSamplePos.coords - P;
         float lightDistance = lightDir.norm();
-        lightDir = normalize(lightDir);
-        float cosIntersectionTheta = dotProduct(intersection.normal, lightDir);
-        float cosLightTheta = dotProduct(lightSamplePos.normal, -lightDir);
-        if (cosIntersectionTheta > 0 && cosLightTheta > 0) 
+        lightDir = lightDir / lightDistance;
+        Ray shadowRay(offsetRayOrigin(P, Ng, lightDir), lightDir);
+        shadowRay.t_max = dotProduct(lightSamplePos.coords - shadowRay.origin, lightDir) * (1.0f - ShadowEpsilon);
+
+        // 前置判断遮挡 避免边界噪音
+        STAT(++Stats::local().shadowRays);
+        if (!intersectP(shadowRay))
         {
-            Vector3f brdf = intersection.m->eval(ray.direction,lightDir, intersection.normal);
-            // 蒙特卡洛
-            intersection.emit = lightSamplePos.emit * brdf * cosIntersectionTheta * cosLightTheta / (lightDistance * lightDistance) / pdfLight;
+            float cosIntersectionTheta = dotProduct(N, lightDir);
+            float cosLightTheta = dotProduct(lightSamplePos.normal, -lightDir);
+            if (pdfLight > 0 && cosIntersectionTheta > 0 && cosLightTheta > 0 && sameSide(Ng, wo, lightDir))
+            {
+                Vector3f brdf = m->eval(ray.direction, lightDir, N);
+                // 转换到立体角的概率密度
+                float lightPdfW = pdfLight * lightDistance * lightDistance / cosLightTheta;
+                float weight = useMIS ? powerHeuristic(lightPdfW, m->pdf(ray.direction, lightDir, N)) : 1.0f;
+                // 蒙特卡洛
+                radiance += throughput * lightSamplePos.emit * brdf * cosIntersectionTheta / lightPdfW * weight;
+            }
         }
-    }
 
-    // Russian Roulette
-    float P_RR = get_random_float();
-    if (P_RR < RussianRoulette) {
         // 下一轮间接光照
-        Vector3f newDir = intersection.m->sample(ray.direction, intersection.normal).normalized();
-        
-        Ray newRay(intersection.coords, newDir);
-        Intersection newIntersection = intersect(newRay);
-        float pdf = intersection.m->pdf(ray.direction, newDir, intersection.normal);
-        if (pdf>0.01 && newIntersection.happened && !newIntersection.m->hasEmission()) 
-        {
-            // 计算新的光照
-            Vector3f newBrdf = intersection.m->eval(ray.direction, newDir, intersection.normal);
-            float cosIntersectionTheta = dotProduct(intersection.normal, newDir);
-            Vector3f indirectLight = castRay(newRay, depth + 1) * newBrdf * cosIntersectionTheta / pdf;
-            intersection.emit += indirectLight / RussianRoulette; // 满足数学期望为全局光照
-        }
+        if (depth + 1 >= maxDepth)
+            break;
+        Vector3f newDir = m->sample(ray.direction, N, sampler).normalized();
+        float pdf = m->pdf(ray.direction, newDir, N);
+        // below the surface though above the shading normal: the path ends
+        // instead of leaking through the mesh
+        if (pdf <= 0 || !sameSide(Ng, wo, newDir))
+            break;
+        throughput = throughput * m->eval(ray.direction, newDir, N) * dotProduct(N, newDir) / pdf;
+        if (!continuePath(throughput, depth, sampler))
+            break;
+
+        ray = Ray(offsetRayOrigin(P, Ng, newDir), newDir);
+        bsdfPdf = pdf;
+        STAT(++Stats::local().indirectRays);
+        intersection = intersect(ray);
     }
 
-    return intersection.emit;
+    // the path ended at a miss, a light or the last surface
+    STAT(if (intersection.happened && !intersection.m->hasEmission()) Stats::local().addPath(depth + 1));
+    return radiance;
+}
+
+bool Scene::continuePath(Vector3f &throughput, int depth, Sampler &sampler) const
+{
+    if (depth + 1 < rouletteDepth)
+        return true;
+    // Russian Roulette: dim paths are likely to stop, bright ones keep going
+    float survival = std::min(RussianRoulette, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+    if (sampler.get1D() >= survival)
+        return false;
+    throughput = throughput / survival; // 满足数学期望为全局光照
+    return true;
+}
+
+float Scene::lightPdf(const Intersection &lightHit, const Vector3f &from) const
+{
+    Vector3f toLight = lightHit.coords - from;
+    float distance2 = dotProduct(toLight, toLight);
+    float cosLightTheta = -dotProduct(normalize(lightHit.geometricNormal), toLight) / std::sqrt(distance2);
+    if (cosLightTheta <= 0)
+        return 0;
+    return lightSampler.pdf(lightHit.obj, lightHit.primId) * distance2 / cosLightTheta;
 }
@@ -9,6 +9,7 @@
 #include "Object.hpp"
 #include "Light.hpp"
 #include "BVH.hpp"
+#include "LightSampler.hpp"
 #include "Ray.hpp"
 
 class Scene
@@ -19,9 +20,20 @@ public:
     int height = 960;
     double fov = 40;
     Vector3f backgroundColor = Vector3f(0.0f,0.0f,0.0f);
-    float RussianRoulette = 0.8;
+    // Russian roulette starts once a path has this many bounces; a path then
+    // survives with the largest channel of its throughput, at most RussianRoulette
+    int rouletteDepth = 3;
+    float RussianRoulette = 0.95f;
+    // surfaces a path may hit at most, the bounce after that is cut off
+    int maxDepth = 64;
+    // shadow rays stop this fraction short of the light sample
+    float ShadowEpsilon = 1e-3f;
+    // weight light and BSDF samples with the power heuristic; off: light
+    // samples only for the direct light (the old estimator)
+    bool useMIS = true;
 
     Scene(int w, int h) : width(w), height(h) {}
+    ~Scene() { delete bvh; }
 
     void Add(Object *object) { objects.push_back(object); }
     void Add(std::unique_ptr<Light> light) { lights.push_back(std::move(light)); }
@@ -29,10 +41,22 @@ public:
     const std::vector<Object*>& get_objects() const { return objects; }
     const std::vector<std::unique_ptr<Light> >&  get_lights() const { return lights; }
     Intersection intersect(const Ray& ray) const;
-    BVHAccel *bvh;
-    void buildBVH();
-    Vector3f castRay(const Ray &ray, int depth) const;
-    void sampleLight(Intersection &pos, float &pdf) const;
+    bool intersectP(const Ray& ray) const;
+    uint64_t intersectPacket(RayPacket& packet, Intersection* hits) const;
+    BVHAccel *bvh = nullptr;
+    // emissive primitives, rebuilt together with the BVH
+    LightSampler lightSampler;
+    // leaves hold up to maxPrimsInNode objects, fewer where the SAH prefers a split
+    void buildBVH(BVHAccel::NodeLayout layout = BVHAccel::NodeLayout::BINARY, int maxPrimsInNode = 4);
+    Vector3f castRay(const Ray &ray, int depth, Sampler &sampler) const;
+    // castRay with the first hit of the ray already known
+    Vector3f shade(const Ray &ray, Intersection intersection, int depth, Sampler &sampler) const;
+    // Russian roulette for the bounce leaving surface `depth` (0 = first hit);
+    // a surviving path's throughput is divided by its survival probability
+    bool continuePath(Vector3f &throughput, int depth, Sampler &sampler) const;
+    void sampleLight(Intersection &pos, float &pdf, Sampler &sampler) const;
+    // solid angle pdf of sampleLight() choosing the point lightHit, seen from `from`
+    float lightPdf(const Intersection &lightHit, const Vector3f &from) const;
     bool trace(const Ray &ray, const std::vector<Object*> &objects, float &tNear, uint32_t &index, Object **hitObject);
 
     // creating the scene (adding objects and lights)
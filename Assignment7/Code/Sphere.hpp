@@ -24,10 +24,9 @@ public:
         float b = 2 * dotProduct(ray.direction, L);
         float c = dotProduct(L, L) - radius2;
         float t0, t1;
-        float area = 4 * M_PI * radius2;
         if (!solveQuadratic(a, b, c, t0, t1)) return false;
         if (t0 < 0) t0 = t1;
-        if (t0 < 0) return false;
+        if (t0 < 0 || t0 >= ray.t_max) return false;
         return true;
     }
     bool intersect(const Ray& ray, float &tnear, uint32_t &index) const
@@ -46,36 +45,43 @@ public:
 
         return true;
     }
-    Intersection getIntersection(Ray ray){
-        Intersection result;
-        result.happened = false;
+    bool closestHit(const Ray& ray, HitRecord& hit){
         Vector3f L = ray.origin - center;
         float a = dotProduct(ray.direction, ray.direction);
         float b = 2 * dotProduct(ray.direction, L);
         float c = dotProduct(L, L) - radius2;
         float t0, t1;
-        if (!solveQuadratic(a, b, c, t0, t1)) return result;
+        if (!solveQuadratic(a, b, c, t0, t1)) return false;
         if (t0 < 0) t0 = t1;
-        if (t0 < 0) return result;
-        result.happened=true;
-
-        result.coords = Vector3f(ray.origin + ray.direction * t0);
+        if (t0 < 0 || t0 >= hit.t) return false;
+        hit.t = t0;
+        hit.obj = this;
+        hit.primId = 0;
+        return true;
+    }
+    SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit){
+        SurfaceInteraction result;
+        result.happened = true;
+        result.coords = Vector3f(ray.origin + ray.direction * hit.t);
         result.normal = normalize(Vector3f(result.coords - center));
+        result.geometricNormal = result.normal;
         result.m = this->m;
         result.obj = this;
-        result.distance = t0;
+        result.distance = hit.t;
         return result;
-
     }
     void getSurfaceProperties(const Vector3f &P, const Vector3f &I, const uint32_t &index, const Vector2f &uv, Vector3f &N, Vector2f &st) const
     { N = normalize(P - center); }
+    Vector3f evalDiffuseColor(const Vector2f &st)const {
+        return m->getAlbedo();
+    }
 
     Bounds3 getBounds(){
         return Bounds3(Vector3f(center.x-radius, center.y-radius, center.z-radius),
                        Vector3f(center.x+radius, center.y+radius, center.z+radius));
     }
-    void Sample(Intersection &pos, float &pdf){
-        float theta = 2.0 * M_PI * get_random_float(), phi = M_PI * get_random_float();
+    void Sample(Intersection &pos, float &pdf, Sampler &sampler){
+        float theta = 2.0 * M_PI * sampler.get1D(), phi = M_PI * sampler.get1D();
         Vector3f dir(std::cos(phi), std::sin(phi)*std::cos(theta), std::sin(phi)*std::sin(theta));
         pos.coords = center + radius * dir;
         pos.normal = dir;
@@ -88,6 +94,9 @@ public:
     bool hasEmit(){
         return m->hasEmission();
     }
+    std::vector<Material*> getMaterials(){
+        return {m};
+    }
 };
 
 #endif //RAYTRACING_SPHERE_H
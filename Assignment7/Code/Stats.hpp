@@ -0,0 +1,139 @@
+#pragma once
+#ifndef RAYTRACING_STATS_H
+#define RAYTRACING_STATS_H
+
+// Traversal and path statistics, compiled in only with the CMake option
+// RAYTRACING_STATS. Every thread counts into its own thread_local block, so the
+// hot path has no atomics; Stats::collect() sums and clears all blocks once a
+// render is done. Without the option the STAT() statements and the cost
+// scopes expand to nothing.
+#ifdef RAYTRACING_STATS
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+struct RenderStats
+{
+    // longer paths share the last bucket
+    static constexpr int MaxPathLength = 16;
+
+    uint64_t nodesVisited = 0, boxTests = 0, primitiveTests = 0;
+    uint64_t cameraRays = 0, indirectRays = 0, shadowRays = 0;
+    // paths by number of surface hits, a camera ray that misses has length 0
+    uint64_t pathLength[MaxPathLength + 1] = {};
+
+    // the unit of the cost heatmap
+    uint64_t traversalCost() const { return nodesVisited + primitiveTests; }
+
+    void addPath(int length) { ++pathLength[length < MaxPathLength ? length : MaxPathLength]; }
+
+    RenderStats& operator+=(const RenderStats& other)
+    {
+        nodesVisited += other.nodesVisited;
+        boxTests += other.boxTests;
+        primitiveTests += other.primitiveTests;
+        cameraRays += other.cameraRays;
+        indirectRays += other.indirectRays;
+        shadowRays += other.shadowRays;
+        for (int i = 0; i <= MaxPathLength; ++i)
+            pathLength[i] += other.pathLength[i];
+        return *this;
+    }
+
+    void print() const
+    {
+        uint64_t rays = cameraRays + indirectRays + shadowRays;
+        uint64_t paths = 0, vertices = 0;
+        for (int i = 0; i <= MaxPathLength; ++i) {
+            paths += pathLength[i];
+            vertices += pathLength[i] * i;
+        }
+        double perRay = rays ? 1.0 / rays : 0.0;
+        printf("Rays: %llu camera, %llu indirect, %llu shadow\n", (unsigned long long)cameraRays,
+               (unsigned long long)indirectRays, (unsigned long long)shadowRays);
+        printf("Per ray: %.1f nodes visited, %.1f box tests, %.1f primitive tests\n", nodesVisited * perRay,
+               boxTests * perRay, primitiveTests * perRay);
+        printf("Path length (mean %.2f):", paths ? vertices / (double)paths : 0.0);
+        for (int i = 0; i <= MaxPathLength; ++i)
+            if (pathLength[i])
+                printf(" %d%s: %.2f%%", i, i == MaxPathLength ? "+" : "", 100.0 * pathLength[i] / paths);
+        printf("\n");
+    }
+};
+
+namespace Stats
+{
+    // the blocks of all threads that have counted something; a block lives
+    // as long as its thread and hands its counts to `retired` on exit
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<RenderStats*> blocks;
+        RenderStats retired;
+    };
+    inline Registry registry;
+
+    struct ThreadBlock
+    {
+        RenderStats stats;
+        ThreadBlock()
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.blocks.push_back(&stats);
+        }
+        ~ThreadBlock()
+        {
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.retired += stats;
+            for (RenderStats*& block : registry.blocks)
+                if (block == &stats)
+                    block = registry.blocks.back();
+            registry.blocks.pop_back();
+        }
+    };
+
+    inline RenderStats& local()
+    {
+        thread_local ThreadBlock block;
+        return block.stats;
+    }
+
+    // sum of all threads' counts since the last collect(); call it while no thread traces
+    inline RenderStats collect()
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        RenderStats total = registry.retired;
+        registry.retired = RenderStats();
+        for (RenderStats* block : registry.blocks) {
+            total += *block;
+            *block = RenderStats();
+        }
+        return total;
+    }
+
+    // adds this thread's traversal cost within the scope to `target`
+    class CostScope
+    {
+    public:
+        explicit CostScope(float& target) : target(target), start(local().traversalCost()) {}
+        ~CostScope() { target += (float)(local().traversalCost() - start); }
+
+    private:
+        float& target;
+        uint64_t start;
+    };
+}
+
+#define STAT(statement) do { statement; } while (0)
+#define STAT_COST_SCOPE(target) Stats::CostScope statCostScope(target)
+
+#else
+
+#define STAT(statement) do {} while (0)
+#define STAT_COST_SCOPE(target) do {} while (0)
+
+#endif
+
+#endif //RAYTRACING_STATS_H
@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < numThreads; ++i)
+        queues.push_back(std::make_unique<WorkQueue>());
+    for (int i = 0; i < numThreads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& body)
+{
+    if (count <= 0)
+        return;
+
+    int n = size();
+    for (int w = 0; w < n; ++w) {
+        int begin = (int)((long long)count * w / n);
+        int end = (int)((long long)count * (w + 1) / n);
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (int i = begin; i < end; ++i)
+            queues[w]->items.push_back(i);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &body;
+    activeWorkers = n;
+    ++generation;
+    wakeCondition.notify_all();
+    doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+bool ThreadPool::popOrSteal(int worker, int& index)
+{
+    {
+        WorkQueue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.items.empty()) {
+            index = own.items.back();
+            own.items.pop_back();
+            return true;
+        }
+    }
+    int n = size();
+    for (int k = 1; k < n; ++k) {
+        WorkQueue& victim = *queues[(worker + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.items.empty()) {
+            index = victim.items.front();
+            victim.items.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    uint64_t seenGeneration = 0;
+    while (true) {
+        const std::function<void(int, int)>* body;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = generation;
+            body = job;
+        }
+
+        int index;
+        while (popOrSteal(worker, index))
+            (*body)(index, worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--activeWorkers == 0)
+            doneCondition.notify_one();
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef RAYTRACING_THREADPOOL_H
+#define RAYTRACING_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool. parallelFor() hands every worker a contiguous slice
+// of the index range in its own deque; a worker that runs dry steals from the
+// front of the other deques, so uneven work (e.g. tiles covering a dense mesh)
+// is rebalanced without a global lock per item.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers.size(); }
+
+    // body(index, workerIndex) for every index in [0, count); blocks until done
+    void parallelFor(int count, const std::function<void(int, int)>& body);
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<int> items;
+    };
+
+    void workerLoop(int worker);
+    bool popOrSteal(int worker, int& index);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition, doneCondition;
+    const std::function<void(int, int)>* job = nullptr;
+    uint64_t generation = 0;
+    int activeWorkers = 0;
+    bool stopping = false;
+};
+
+#endif //RAYTRACING_THREADPOOL_H
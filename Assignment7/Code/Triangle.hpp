@@ -4,11 +4,16 @@
 #include "Intersection.hpp"
 #include "Material.hpp"
 #include "OBJ_Loader.hpp"
+#include "FastObjLoader.hpp"
 #include "Object.hpp"
 #include "Triangle.hpp"
 #include "Matrix.hpp"
+#include "MeshCache.hpp"
 #include <cassert>
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <unordered_map>
 
 bool rayTriangleIntersect(const Vector3f& v0, const Vector3f& v1,
                           const Vector3f& v2, const Vector3f& orig,
@@ -62,7 +67,8 @@ public:
     bool intersect(const Ray& ray) override;
     bool intersect(const Ray& ray, float& tnear,
                    uint32_t& index) const override;
-    Intersection getIntersection(Ray ray) override;
+    bool closestHit(const Ray& ray, HitRecord& hit) override;
+    SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit) override;
     void getSurfaceProperties(const Vector3f& P, const Vector3f& I,
                               const uint32_t& index, const Vector2f& uv,
                               Vector3f& N, Vector2f& st) const override
@@ -71,8 +77,8 @@ public:
     }
     Vector3f evalDiffuseColor(const Vector2f&) const override;
     Bounds3 getBounds() override;
-    void Sample(Intersection &pos, float &pdf)override{
-        float x = std::sqrt(get_random_float()), y = get_random_float();
+    void Sample(Intersection &pos, float &pdf, Sampler &sampler)override{
+        float x = std::sqrt(sampler.get1D()), y = sampler.get1D();
         pos.coords = v0 * (1.0f - x) + v1 * (x * (1.0f - y)) + v2 * (x * y);
         pos.normal = this->normal;
         pdf = 1.0f / area;
@@ -83,88 +89,137 @@ public:
     bool hasEmit()override{
         return m->hasEmission();
     }
+    std::vector<Material*> getMaterials()override{
+        return {m};
+    }
 };
 
 class MeshTriangle : public Object
 {
 public:
     // TODO MISSION
-    MeshTriangle(const std::string& filename, Material *mt = new Material(), const Matrix4f& modelMatrix = Matrix4f::Identity())
+    // maxPrimsInNode: triangles per BVH leaf at most, the SAH decides below that
+    MeshTriangle(const std::string& filename, Material *mt = new Material(), const Matrix4f& modelMatrix = Matrix4f::Identity(),
+                 BVHAccel::NodeLayout layout = BVHAccel::NodeLayout::BINARY, int maxPrimsInNode = 4)
     {
-        objl::Loader loader;
-        loader.LoadFile(filename);
         area = 0;
         m = mt;
+        triangles.materials.push_back(mt);
+
+        // a cache built from the same OBJ bytes and transform skips parsing and the BVH build
+        const BVHAccel::SplitMethod splitMethod = BVHAccel::SplitMethod::SAH;
+        uint64_t sourceHash = MeshCache::enabled ? MeshCache::hashFile(filename) : 0;
+        std::string cacheFile = MeshCache::path(filename, modelMatrix, maxPrimsInNode, splitMethod, fastObjLoader);
+        std::vector<LinearBVHNode> cachedNodes;
+        if (sourceHash && MeshCache::load(cacheFile, sourceHash, triangles, cachedNodes, bounding_box)) {
+            bvh = new BVHAccel(&triangles, std::move(cachedNodes), maxPrimsInNode, splitMethod, layout);
+            printf("Loaded %s from cache: %d triangles\n", filename.c_str(), (int)triangles.numTriangles());
+        } else {
+            loadObj(filename, modelMatrix);
+            bvh = new BVHAccel(&triangles, maxPrimsInNode, splitMethod, layout);
+            if (sourceHash && !MeshCache::save(cacheFile, sourceHash, triangles, bvh->nodes, bounding_box))
+                std::cerr << "Cannot write mesh cache " << cacheFile << "\n";
+        }
 
-        Vector3f min_vert = Vector3f{std::numeric_limits<float>::infinity(),
-                                 std::numeric_limits<float>::infinity(),
-                                 std::numeric_limits<float>::infinity()};
-        Vector3f max_vert = Vector3f{-std::numeric_limits<float>::infinity(),
-                                 -std::numeric_limits<float>::infinity(),
-                                 -std::numeric_limits<float>::infinity()};
-        
-        // 处理所有网格                         
-        for (auto& mesh : loader.LoadedMeshes) {
-            for (int i = 0; i < mesh.Vertices.size(); i += 3) {
-                std::array<Vector3f, 3> face_vertices;
+        // area CDF in the final (BVH) triangle order for light sampling
+        areaCdf.reserve(triangles.numTriangles());
+        for (size_t i = 0; i < triangles.numTriangles(); ++i) {
+            area += triangles.area(i);
+            areaCdf.push_back(area);
+        }
+    }
 
-                // 确保有足够的顶点
-                if (i + 2 >= mesh.Vertices.size()) 
-                    continue;
+    ~MeshTriangle() { delete bvh; }
+    MeshTriangle(const MeshTriangle&) = delete;
+    MeshTriangle& operator=(const MeshTriangle&) = delete;
 
-                for (int j = 0; j < 3; j++) {
-                    // 获取原始顶点
-                    Vector3f orig_vert(mesh.Vertices[i + j].Position.X,
-                                     mesh.Vertices[i + j].Position.Y,
-                                     mesh.Vertices[i + j].Position.Z);
-                    
-                    // 应用变换矩阵
-                    Vector3f vert = modelMatrix * orig_vert;
-
-                    face_vertices[j] = vert;
-                    
-                    min_vert = Vector3f(std::min(min_vert.x, vert.x),
-                                   std::min(min_vert.y, vert.y),
-                                   std::min(min_vert.z, vert.z));
-                    max_vert = Vector3f(std::max(max_vert.x, vert.x),
-                                   std::max(max_vert.y, vert.y),
-                                   std::max(max_vert.z, vert.z));
+    // parse the OBJ into `triangles` in world space (modelMatrix applied). Corners
+    // with the same position, normal and uv are welded into one vertex, so a
+    // closed mesh stores each vertex once instead of once per adjacent face.
+    void loadObj(const std::string& filename, const Matrix4f& modelMatrix)
+    {
+        // normals go through the inverse transpose to stay perpendicular under scaling
+        Matrix4f normalMatrix = modelMatrix.Inverse().Transpose();
+        std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexMap;
+        auto addVertex = [&](const Vector3f& p, const Vector3f& n, const Vector2f& uv) {
+            auto it = vertexMap.emplace(VertexKey{p.x, p.y, p.z, n.x, n.y, n.z, uv.x, uv.y},
+                                        (uint32_t)triangles.positions.size());
+            if (it.second) {
+                triangles.positions.push_back(p);
+                bounding_box = Union(bounding_box, p);
+            }
+            return it.first->second;
+        };
+
+        if (fastObjLoader) {
+            fastobj::Mesh mesh;
+            if (!fastobj::load(filename, mesh))
+                std::cout << "Cannot open " << filename << "\n";
+            // smooth shaded / textured only if every corner has a normal / uv
+            bool hasNormals = !mesh.normals.empty() &&
+                std::find(mesh.normalIndices.begin(), mesh.normalIndices.end(), -1) == mesh.normalIndices.end();
+            bool hasTexcoords = !mesh.texcoords.empty() &&
+                std::find(mesh.texcoordIndices.begin(), mesh.texcoordIndices.end(), -1) == mesh.texcoordIndices.end();
+            for (size_t t = 0; t < mesh.numTriangles(); ++t) {
+                uint32_t face_vertices[3];
+                for (int k = 0; k < 3; ++k) {
+                    size_t c = 3 * t + k;
+                    const float* pos = &mesh.positions[3 * (size_t)mesh.positionIndices[c]];
+                    Vector3f p = modelMatrix * Vector3f(pos[0], pos[1], pos[2]);
+                    Vector3f n(0.0f);
+                    Vector2f uv(0.0f, 0.0f);
+                    if (hasNormals) {
+                        const float* nor = &mesh.normals[3 * (size_t)mesh.normalIndices[c]];
+                        n = normalize(normalMatrix.transformVector(Vector3f(nor[0], nor[1], nor[2])));
+                    }
+                    if (hasTexcoords) {
+                        const float* tex = &mesh.texcoords[2 * (size_t)mesh.texcoordIndices[c]];
+                        uv = Vector2f(tex[0], tex[1]);
+                    }
+                    face_vertices[k] = addVertex(p, n, uv);
+                    if (hasNormals && face_vertices[k] == triangles.normals.size())
+                        triangles.normals.push_back(n);
+                    if (hasTexcoords && face_vertices[k] == triangles.texcoords.size())
+                        triangles.texcoords.push_back(uv);
                 }
-
-                triangles.emplace_back(face_vertices[0], face_vertices[1], face_vertices[2], mt);
+                triangles.addTriangle(face_vertices[0], face_vertices[1], face_vertices[2], 0);
             }
+            return;
         }
 
-        bounding_box = Bounds3(min_vert, max_vert);
-
-        std::vector<Object*> ptrs;
-        for (auto& tri : triangles){
-            ptrs.push_back(&tri);
-            area += tri.area;
+        // objl 展开成三角形汤, 且总会给出法线(缺失时用面法线)
+        objl::Loader loader;
+        loader.LoadFile(filename);
+        for (auto& mesh : loader.LoadedMeshes) {
+            for (size_t i = 0; i + 2 < mesh.Vertices.size(); i += 3) {
+                uint32_t face_vertices[3];
+                for (int j = 0; j < 3; j++) {
+                    const objl::Vertex& corner = mesh.Vertices[i + j];
+                    Vector3f p = modelMatrix * Vector3f(corner.Position.X, corner.Position.Y, corner.Position.Z);
+                    Vector3f n = normalize(normalMatrix.transformVector(
+                        Vector3f(corner.Normal.X, corner.Normal.Y, corner.Normal.Z)));
+                    Vector2f uv(corner.TextureCoordinate.X, corner.TextureCoordinate.Y);
+                    face_vertices[j] = addVertex(p, n, uv);
+                    if (face_vertices[j] == triangles.normals.size()) {
+                        triangles.normals.push_back(n);
+                        triangles.texcoords.push_back(uv);
+                    }
+                }
+                triangles.addTriangle(face_vertices[0], face_vertices[1], face_vertices[2], 0);
+            }
         }
-        bvh = new BVHAccel(ptrs);
     }
 
-    bool intersect(const Ray& ray) { return true; }
+    bool intersect(const Ray& ray) { return bvh && bvh->IntersectP(ray); }
 
     bool intersect(const Ray& ray, float& tnear, uint32_t& index) const
     {
-        bool intersect = false;
-        for (uint32_t k = 0; k < numTriangles; ++k) {
-            const Vector3f& v0 = vertices[vertexIndex[k * 3]];
-            const Vector3f& v1 = vertices[vertexIndex[k * 3 + 1]];
-            const Vector3f& v2 = vertices[vertexIndex[k * 3 + 2]];
-            float t, u, v;
-            if (rayTriangleIntersect(v0, v1, v2, ray.origin, ray.direction, t,
-                                     u, v) &&
-                t < tnear) {
-                tnear = t;
-                index = k;
-                intersect |= true;
-            }
-        }
-
-        return intersect;
+        int primId = -1;
+        float u, v;
+        if (!triangles.intersect(ray, 0, (int)triangles.numTriangles(), tnear, primId, u, v))
+            return false;
+        index = (uint32_t)primId;
+        return true;
     }
 
     Bounds3 getBounds() { return bounding_box; }
@@ -173,16 +228,8 @@ public:
                               const uint32_t& index, const Vector2f& uv,
                               Vector3f& N, Vector2f& st) const
     {
-        const Vector3f& v0 = vertices[vertexIndex[index * 3]];
-        const Vector3f& v1 = vertices[vertexIndex[index * 3 + 1]];
-        const Vector3f& v2 = vertices[vertexIndex[index * 3 + 2]];
-        Vector3f e0 = normalize(v1 - v0);
-        Vector3f e1 = normalize(v2 - v1);
-        N = normalize(crossProduct(e0, e1));
-        const Vector2f& st0 = stCoordinates[vertexIndex[index * 3]];
-        const Vector2f& st1 = stCoordinates[vertexIndex[index * 3 + 1]];
-        const Vector2f& st2 = stCoordinates[vertexIndex[index * 3 + 2]];
-        st = st0 * (1 - uv.x - uv.y) + st1 * uv.x + st2 * uv.y;
+        N = triangles.shadingNormal(index, uv.x, uv.y);
+        st = triangles.texcoord(index, uv.x, uv.y);
     }
 
     Vector3f evalDiffuseColor(const Vector2f& st) const
@@ -194,20 +241,46 @@ public:
                     Vector3f(0.937, 0.937, 0.231), pattern);
     }
 
-    Intersection getIntersection(Ray ray)
+    bool closestHit(const Ray& ray, HitRecord& hit)
     {
-        Intersection intersec;
+        if (!bvh || !bvh->closestHit(ray, hit))
+            return false;
+        hit.obj = this;
+        return true;
+    }
 
-        if (bvh) {
-            intersec = bvh->Intersect(ray);
-        }
+    SurfaceInteraction surfaceInteraction(const Ray& ray, const HitRecord& hit)
+    {
+        SurfaceInteraction isect = bvh->surfaceInteraction(ray, hit);
+        isect.obj = this;
+        return isect;
+    }
 
-        return intersec;
+    uint64_t closestHits(RayPacket& packet, HitRecord* hits)
+    {
+        uint64_t hitMask = bvh ? bvh->closestHits(packet, hits) : 0;
+        for (int i = 0; i < packet.size(); ++i)
+            if (hitMask & (uint64_t(1) << i))
+                hits[i].obj = this;
+        return hitMask;
     }
     
-    void Sample(Intersection &pos, float &pdf){
-        bvh->Sample(pos, pdf);
+    // uniform over the mesh surface: pick a triangle by area, then a point on it
+    void Sample(Intersection &pos, float &pdf, Sampler &sampler){
+        float p = sampler.get1D() * area;
+        size_t i = std::min(size_t(std::upper_bound(areaCdf.begin(), areaCdf.end(), p) - areaCdf.begin()),
+                            areaCdf.size() - 1);
+        SamplePrimitive((int)i, pos, pdf, sampler);
+        pdf = 1.0f / area;
+    }
+    int getPrimitiveCount() { return (int)triangles.numTriangles(); }
+    float getPrimitiveArea(int i) { return triangles.area(i); }
+    void SamplePrimitive(int i, Intersection &pos, float &pdf, Sampler &sampler){
+        float x = std::sqrt(sampler.get1D()), y = sampler.get1D();
+        pos.coords = triangles.v0(i) + triangles.e1[i] * (x * (1.0f - y)) + triangles.e2[i] * (x * y);
+        pos.normal = triangles.normal(i);
         pos.emit = m->getEmission();
+        pdf = 1.0f / triangles.area(i);
     }
     float getArea(){
         return area;
@@ -215,22 +288,64 @@ public:
     bool hasEmit(){
         return m->hasEmission();
     }
+    std::vector<Material*> getMaterials(){
+        return triangles.materials;
+    }
+
+    // parse OBJ files with fastobj (parallel, indexed) instead of objl::Loader
+    static inline bool fastObjLoader = true;
 
     Bounds3 bounding_box;
-    std::unique_ptr<Vector3f[]> vertices;
-    uint32_t numTriangles;
-    std::unique_ptr<uint32_t[]> vertexIndex;
-    std::unique_ptr<Vector2f[]> stCoordinates;
 
-    std::vector<Triangle> triangles;
+    TriangleMesh triangles;
+    std::vector<float> areaCdf;
 
-    BVHAccel* bvh;
+    BVHAccel* bvh = nullptr;
     float area;
 
     Material* m;
+
+private:
+    // position, normal and uv of a corner, compared bitwise
+    struct VertexKey {
+        float v[8];
+        bool operator==(const VertexKey& o) const { return memcmp(v, o.v, sizeof(v)) == 0; }
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& k) const
+        {
+            size_t h = 0xcbf29ce484222325ull;
+            for (float f : k.v) {
+                uint32_t bits;
+                memcpy(&bits, &f, sizeof(bits));
+                h = (h ^ bits) * 0x100000001b3ull;
+            }
+            return h;
+        }
+    };
 };
 
-inline bool Triangle::intersect(const Ray& ray) { return true; }
+inline bool Triangle::intersect(const Ray& ray)
+{
+    if (dotProduct(ray.direction, normal) > 0)
+        return false;
+    Vector3f pvec = crossProduct(ray.direction, e2);
+    float det = dotProduct(e1, pvec);
+    if (fabs(det) < EPSILON * area)
+        return false;
+
+    float det_inv = 1.f / det;
+    Vector3f tvec = ray.origin - v0;
+    float u = dotProduct(tvec, pvec) * det_inv;
+    if (u < 0 || u > 1)
+        return false;
+    Vector3f qvec = crossProduct(tvec, e1);
+    float v = dotProduct(ray.direction, qvec) * det_inv;
+    if (v < 0 || u + v > 1)
+        return false;
+    float t = dotProduct(e2, qvec) * det_inv;
+    return t >= 0.f && t < ray.t_max;
+}
 inline bool Triangle::intersect(const Ray& ray, float& tnear,
                                 uint32_t& index) const
 {
@@ -240,50 +355,44 @@ inline bool Triangle::intersect(const Ray& ray, float& tnear,
 inline Bounds3 Triangle::getBounds() { return Union(Bounds3(v0, v1), v2); }
 
 // TODO MISSION
-inline Intersection Triangle::getIntersection(Ray ray)
+// Moller-Trumbore, the same kernel as TriangleMesh::intersect: back faces
+// (det <= 0) are culled
+inline bool Triangle::closestHit(const Ray& ray, HitRecord& hit)
 {
-    Intersection inter;
-
-    if (dotProduct(ray.direction, normal) > 0)
-        return inter;
-    double u, v, t_tmp = 0;
     Vector3f pvec = crossProduct(ray.direction, e2);
-    double det = dotProduct(e1, pvec);
-    if (fabs(det) < EPSILON)
-        return inter;
-
-    double det_inv = 1. / det;
+    float det = dotProduct(e1, pvec);
+    if (!(det > 0))
+        return false;
+    float invDet = 1.0f / det;
     Vector3f tvec = ray.origin - v0;
-    u = dotProduct(tvec, pvec) * det_inv;
-    if (u < 0 || u > 1)
-        return inter;
+    float b1 = dotProduct(tvec, pvec) * invDet;
+    if (b1 < 0 || b1 > 1)
+        return false;
     Vector3f qvec = crossProduct(tvec, e1);
-    v = dotProduct(ray.direction, qvec) * det_inv;
-    if (v < 0 || u + v > 1)
-        return inter;
-    t_tmp = dotProduct(e2, qvec) * det_inv;
-
-    // TODO find ray triangle intersection
-    auto S = ray.origin - v0;
-    auto E1 = v1 - v0;
-    auto E2 = v2 - v0;
-    auto S1 = crossProduct(ray.direction, E2);
-    auto S2 = crossProduct(S, E1);
-
-    float S1E1 = dotProduct(S1, E1);
-    float t = dotProduct(S2, E2) / S1E1;
-    float b1 = dotProduct(S1, S) / S1E1;
-    float b2 = dotProduct(S2, ray.direction) / S1E1;
-    
-    if (t >= 0.f && b1 >= 0.f && b2 >= 0.f && (1 - b1 - b2) >= 0.f) {
-        inter.coords = Vector3f(ray.origin + ray.direction * t);
-        inter.distance = t;
-        inter.happened = true;
-        inter.obj = this;
-        inter.normal = normal;
-        inter.m = m;
-    }
+    float b2 = dotProduct(ray.direction, qvec) * invDet;
+    if (b2 < 0 || b1 + b2 > 1)
+        return false;
+    float t = dotProduct(e2, qvec) * invDet;
+    if (t < 0 || t >= hit.t)
+        return false;
+    hit.t = t;
+    hit.obj = this;
+    hit.primId = 0;
+    hit.u = b1;
+    hit.v = b2;
+    return true;
+}
 
+inline SurfaceInteraction Triangle::surfaceInteraction(const Ray& ray, const HitRecord& hit)
+{
+    SurfaceInteraction inter;
+    inter.coords = Vector3f(ray.origin + ray.direction * hit.t);
+    inter.distance = hit.t;
+    inter.happened = true;
+    inter.obj = this;
+    inter.normal = normal;
+    inter.geometricNormal = normal;
+    inter.m = m;
     return inter;
 }
 
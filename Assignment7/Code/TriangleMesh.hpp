@@ -0,0 +1,156 @@
+#pragma once
+#ifndef RAYTRACING_TRIANGLEMESH_H
+#define RAYTRACING_TRIANGLEMESH_H
+
+#include <cstdint>
+#include <vector>
+#include "Vector.hpp"
+#include "Bounds3.hpp"
+#include "Ray.hpp"
+
+class Material;
+
+// Mesh-level structure-of-arrays triangle store. Triangle i uses the shared
+// vertices indices[3i..3i+2]; its edges are precomputed for the intersection
+// kernel and its material is a small index into `materials`. Compared to one
+// polymorphic Triangle object per face this is ~40 bytes per triangle plus the
+// shared vertices. A vertex is a welded (position, normal, uv) triple; the
+// normal and uv arrays are empty when the source has none.
+struct TriangleMesh
+{
+    std::vector<Vector3f> positions;
+    std::vector<Vector3f> normals;       // per vertex, for smooth shading
+    std::vector<Vector2f> texcoords;     // per vertex
+    std::vector<uint32_t> indices;
+    std::vector<Vector3f> e1, e2;        // v1 - v0, v2 - v0
+    std::vector<uint16_t> materialIds;
+    std::vector<Material*> materials;
+
+    size_t numTriangles() const { return e1.size(); }
+
+    void addTriangle(uint32_t i0, uint32_t i1, uint32_t i2, uint16_t materialId)
+    {
+        indices.push_back(i0);
+        indices.push_back(i1);
+        indices.push_back(i2);
+        e1.push_back(positions[i1] - positions[i0]);
+        e2.push_back(positions[i2] - positions[i0]);
+        materialIds.push_back(materialId);
+    }
+
+    const Vector3f& v0(size_t i) const { return positions[indices[3 * i]]; }
+    Vector3f normal(size_t i) const { return normalize(crossProduct(e1[i], e2[i])); }
+    float area(size_t i) const { return crossProduct(e1[i], e2[i]).norm() * 0.5f; }
+    Material* material(size_t i) const { return materials[materialIds[i]]; }
+
+    // vertex normals interpolated at the barycentrics (u, v) of triangle i,
+    // kept on the front side of the face; the face normal without them
+    Vector3f shadingNormal(size_t i, float u, float v) const
+    {
+        Vector3f face = normal(i);
+        if (normals.empty())
+            return face;
+        const uint32_t* tri = &indices[3 * i];
+        Vector3f n = normals[tri[0]] * (1 - u - v) + normals[tri[1]] * u + normals[tri[2]] * v;
+        float length = n.norm();
+        return length > 0 && dotProduct(n, face) > 0 ? n / length : face;
+    }
+    Vector2f texcoord(size_t i, float u, float v) const
+    {
+        if (texcoords.empty())
+            return Vector2f(u, v);
+        const uint32_t* tri = &indices[3 * i];
+        return texcoords[tri[0]] * (1 - u - v) + texcoords[tri[1]] * u + texcoords[tri[2]] * v;
+    }
+
+    size_t memoryBytes() const
+    {
+        return positions.size() * sizeof(Vector3f) + normals.size() * sizeof(Vector3f) +
+               texcoords.size() * sizeof(Vector2f) + indices.size() * sizeof(uint32_t) +
+               (e1.size() + e2.size()) * sizeof(Vector3f) + materialIds.size() * sizeof(uint16_t);
+    }
+
+    Bounds3 triangleBounds(size_t i) const
+    {
+        const Vector3f& p0 = v0(i);
+        return Union(Bounds3(p0, p0 + e1[i]), p0 + e2[i]);
+    }
+
+    // Permute the per-triangle arrays so triangle i becomes order[i]
+    void reorder(const std::vector<int>& order)
+    {
+        std::vector<uint32_t> newIndices(indices.size());
+        std::vector<Vector3f> newE1(order.size()), newE2(order.size());
+        std::vector<uint16_t> newMaterialIds(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (int k = 0; k < 3; ++k)
+                newIndices[3 * i + k] = indices[3 * order[i] + k];
+            newE1[i] = e1[order[i]];
+            newE2[i] = e2[order[i]];
+            newMaterialIds[i] = materialIds[order[i]];
+        }
+        indices.swap(newIndices);
+        e1.swap(newE1);
+        e2.swap(newE2);
+        materialIds.swap(newMaterialIds);
+    }
+
+    // Moller-Trumbore over the contiguous range [first, first + count).
+    // Back faces are culled like Triangle::closestHit. On a closer hit
+    // tMax, primId and the barycentrics (u, v) are updated.
+    bool intersect(const Ray& ray, int first, int count, float& tMax,
+                   int& primId, float& u, float& v) const
+    {
+        bool hit = false;
+        for (int i = first; i < first + count; ++i) {
+            Vector3f pvec = crossProduct(ray.direction, e2[i]);
+            float det = dotProduct(e1[i], pvec);
+            if (!(det > 0))
+                continue;
+            float invDet = 1.0f / det;
+            Vector3f tvec = ray.origin - v0(i);
+            float b1 = dotProduct(tvec, pvec) * invDet;
+            if (b1 < 0 || b1 > 1)
+                continue;
+            Vector3f qvec = crossProduct(tvec, e1[i]);
+            float b2 = dotProduct(ray.direction, qvec) * invDet;
+            if (b2 < 0 || b1 + b2 > 1)
+                continue;
+            float t = dotProduct(e2[i], qvec) * invDet;
+            if (t < 0 || t >= tMax)
+                continue;
+            tMax = t;
+            primId = i;
+            u = b1;
+            v = b2;
+            hit = true;
+        }
+        return hit;
+    }
+
+    // Any-hit version of intersect()
+    bool intersectP(const Ray& ray, int first, int count, float tMax) const
+    {
+        for (int i = first; i < first + count; ++i) {
+            Vector3f pvec = crossProduct(ray.direction, e2[i]);
+            float det = dotProduct(e1[i], pvec);
+            if (!(det > 0))
+                continue;
+            float invDet = 1.0f / det;
+            Vector3f tvec = ray.origin - v0(i);
+            float b1 = dotProduct(tvec, pvec) * invDet;
+            if (b1 < 0 || b1 > 1)
+                continue;
+            Vector3f qvec = crossProduct(tvec, e1[i]);
+            float b2 = dotProduct(ray.direction, qvec) * invDet;
+            if (b2 < 0 || b1 + b2 > 1)
+                continue;
+            float t = dotProduct(e2[i], qvec) * invDet;
+            if (t >= 0 && t < tMax)
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif //RAYTRACING_TRIANGLEMESH_H
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include "Wavefront.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+} // namespace
+
+void WavefrontIntegrator::renderTile(int x0, int y0, int x1, int y1, int spp, uint64_t sampleOffset,
+                                     const CameraFn& camera, std::vector<Vector3f>& framebuffer)
+{
+    this->x0 = x0; this->y0 = y0; this->x1 = x1; this->y1 = y1;
+    this->spp = spp;
+    this->sampleOffset = sampleOffset;
+    this->camera = &camera;
+    this->framebuffer = &framebuffer;
+    nextSample = 0;
+    totalSamples = (long long)(x1 - x0) * (y1 - y0) * spp;
+
+    pixel.resize(batchSize);
+    samplers.assign(batchSize, Sampler(seed));
+    radiance.resize(batchSize);
+    throughput.resize(batchSize);
+    depth.resize(batchSize);
+    bsdfPdf.resize(batchSize);
+    freeSlots.clear();
+    for (int p = batchSize - 1; p >= 0; --p)
+        freeSlots.push_back(p);
+    rayPath.clear(); rayOrigin.clear(); rayDir.clear();
+
+    // finished paths hand their slot back, so the queue is topped up every
+    // iteration instead of draining down to the last Russian roulette survivor
+    while (true) {
+        auto start = Clock::now();
+        generate();
+        times.generate += elapsedMs(start);
+        if (rayPath.empty())
+            break;
+
+        start = Clock::now();
+        extend();
+        times.extend += elapsedMs(start);
+
+        start = Clock::now();
+        shade();
+        times.shade += elapsedMs(start);
+
+        start = Clock::now();
+        connect();
+        times.connect += elapsedMs(start);
+    }
+}
+
+void WavefrontIntegrator::generate()
+{
+    const int width = x1 - x0;
+    while (!freeSlots.empty() && nextSample < totalSamples) {
+        int p = freeSlots.back();
+        freeSlots.pop_back();
+        int local = (int)(nextSample / spp), k = (int)(nextSample % spp);
+        ++nextSample;
+        int i = x0 + local % width, j = y0 + local / width;
+
+        pixel[p] = j * scene.width + i;
+        samplers[p].startPixelSample(pixel[p], sampleOffset + k);
+        radiance[p] = Vector3f(0.0f);
+        throughput[p] = Vector3f(1.0f);
+        depth[p] = 0;
+
+        Ray ray = (*camera)(i, j);
+        rayPath.push_back(p);
+        rayOrigin.push_back(ray.origin);
+        rayDir.push_back(ray.direction);
+    }
+}
+
+void WavefrontIntegrator::extend()
+{
+    size_t n = rayPath.size();
+    hitPos.resize(n);
+    hitNormal.resize(n);
+    hitGeometricNormal.resize(n);
+    hitMaterial.resize(n);
+    shadeQueue.clear();
+    for (size_t q = 0; q < n; ++q) {
+        int p = rayPath[q];
+        STAT(++(depth[p] == 0 ? Stats::local().cameraRays : Stats::local().indirectRays));
+        Intersection isect = scene.intersect(Ray(rayOrigin[q], rayDir[q]));
+        if (!isect.happened || isect.m->hasEmission()) {
+            STAT(Stats::local().addPath(depth[p] + isect.happened));
+            // like castRay: the background only counts when seen directly, a
+            // light hit by a BSDF sample gets its MIS weight against the light samples
+            if (depth[p] == 0)
+                radiance[p] += throughput[p] * (isect.happened ? isect.m->getEmission() : scene.backgroundColor);
+            else if (isect.happened && scene.useMIS)
+                radiance[p] += throughput[p] * isect.m->getEmission() *
+                               powerHeuristic(bsdfPdf[p], scene.lightPdf(isect, rayOrigin[q]));
+            finished.push_back(p);
+            continue;
+        }
+        hitPos[q] = isect.coords;
+        hitNormal[q] = normalize(isect.normal);
+        hitGeometricNormal[q] = isect.geometricNormal;
+        hitMaterial[q] = isect.m;
+        shadeQueue.push_back((int)q);
+    }
+}
+
+void WavefrontIntegrator::shade()
+{
+    // group the hits by material so each BSDF runs over a coherent run
+    std::sort(shadeQueue.begin(), shadeQueue.end(), [&](int a, int b) {
+        return hitMaterial[a] != hitMaterial[b] ? hitMaterial[a] < hitMaterial[b] : a < b;
+    });
+
+    nextPath.clear(); nextOrigin.clear(); nextDir.clear();
+    shadowPath.clear(); shadowOrigin.clear(); shadowDir.clear();
+    shadowContribution.clear(); shadowTMax.clear();
+    for (int q : shadeQueue) {
+        int p = rayPath[q];
+        Sampler& sampler = samplers[p];
+        Material* m = hitMaterial[q];
+        const Vector3f& wo = rayDir[q];
+        const Vector3f& P = hitPos[q];
+        const Vector3f& N = hitNormal[q];
+        const Vector3f& Ng = hitGeometricNormal[q];
+
+        // 对光源采样, the shadow ray is traced in connect()
+        float pdfLight = 0;
+        Intersection lightSamplePos;
+        scene.sampleLight(lightSamplePos, pdfLight, sampler);
+        Vector3f lightNormal = normalize(lightSamplePos.normal);
+        Vector3f lightDir = lightSamplePos.coords - P;
+        float lightDistance = lightDir.norm();
+        lightDir = lightDir / lightDistance;
+        float cosIntersectionTheta = dotProduct(N, lightDir);
+        float cosLightTheta = dotProduct(lightNormal, -lightDir);
+        if (pdfLight > 0 && cosIntersectionTheta > 0 && cosLightTheta > 0 && sameSide(Ng, -wo, lightDir)) {
+            Vector3f brdf = m->eval(wo, lightDir, N);
+            float lightPdfW = pdfLight * lightDistance * lightDistance / cosLightTheta;
+            float weight = scene.useMIS ? powerHeuristic(lightPdfW, m->pdf(wo, lightDir, N)) : 1.0f;
+            shadowPath.push_back(p);
+            Vector3f shadowRayOrigin = offsetRayOrigin(P, Ng, lightDir);
+            shadowOrigin.push_back(shadowRayOrigin);
+            shadowDir.push_back(lightDir);
+            shadowTMax.push_back(dotProduct(lightSamplePos.coords - shadowRayOrigin, lightDir) *
+                                 (1.0f - scene.ShadowEpsilon));
+            shadowContribution.push_back(throughput[p] * lightSamplePos.emit * brdf * cosIntersectionTheta /
+                                         lightPdfW * weight);
+        }
+
+        // next bounce, cut off at the scene's max depth and by Russian roulette
+        if (depth[p] + 1 < scene.maxDepth) {
+            Vector3f newDir = m->sample(wo, N, sampler).normalized();
+            float pdf = m->pdf(wo, newDir, N);
+            // like castRay, a direction below the surface ends the path
+            if (pdf > 0 && sameSide(Ng, -wo, newDir)) {
+                Vector3f brdf = m->eval(wo, newDir, N);
+                throughput[p] = throughput[p] * brdf * dotProduct(N, newDir) / pdf;
+                if (scene.continuePath(throughput[p], depth[p], sampler)) {
+                    bsdfPdf[p] = pdf;
+                    depth[p]++;
+                    nextPath.push_back(p);
+                    nextOrigin.push_back(offsetRayOrigin(P, Ng, newDir));
+                    nextDir.push_back(newDir);
+                    continue;
+                }
+            }
+        }
+        STAT(Stats::local().addPath(depth[p] + 1));
+        finished.push_back(p);
+    }
+
+    rayPath.swap(nextPath);
+    rayOrigin.swap(nextOrigin);
+    rayDir.swap(nextDir);
+}
+
+void WavefrontIntegrator::connect()
+{
+    for (size_t s = 0; s < shadowPath.size(); ++s) {
+        Ray shadowRay(shadowOrigin[s], shadowDir[s]);
+        shadowRay.t_max = shadowTMax[s];
+        STAT(++Stats::local().shadowRays);
+        if (!scene.intersectP(shadowRay))
+            radiance[shadowPath[s]] += shadowContribution[s];
+    }
+
+    // every contribution of these paths is in, resolve them to their pixels
+    std::vector<Vector3f>& fb = *framebuffer;
+    for (int p : finished) {
+        fb[pixel[p]] += radiance[p] / spp;
+        freeSlots.push_back(p);
+    }
+    finished.clear();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef RAYTRACING_WAVEFRONT_H
+#define RAYTRACING_WAVEFRONT_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Scene.hpp"
+#include "Sampler.hpp"
+
+// Stream (wavefront) version of Scene::castRay. Instead of following one path
+// to the end, a batch of paths advances one stage at a time:
+//   generate - camera rays for the next (pixel, sample) pairs
+//   extend   - closest hit for every ray in the queue
+//   shade    - per material: light sample -> shadow queue, BSDF sample -> next rays
+//   connect  - any-hit test of the shadow queue, adds the direct light
+// Path state lives in structure-of-arrays queues indexed by path id, and the
+// estimator (and the random numbers it draws) is the same as castRay's.
+class WavefrontIntegrator
+{
+public:
+    using CameraFn = std::function<Ray(int i, int j)>;
+
+    // wall time spent in each stage, summed over the threads
+    struct StageTimes
+    {
+        double generate = 0, extend = 0, shade = 0, connect = 0;
+        StageTimes& operator+=(const StageTimes& o)
+        {
+            generate += o.generate; extend += o.extend; shade += o.shade; connect += o.connect;
+            return *this;
+        }
+    };
+
+    WavefrontIntegrator(const Scene& scene, int batchSize = 16384, uint64_t seed = 0)
+        : scene(scene), batchSize(batchSize), seed(seed) {}
+
+    // Render spp samples of the pixels [x0, x1) x [y0, y1), adding the pixel
+    // estimates to framebuffer. Sample indices start at sampleOffset.
+    void renderTile(int x0, int y0, int x1, int y1, int spp, uint64_t sampleOffset,
+                    const CameraFn& camera, std::vector<Vector3f>& framebuffer);
+
+    StageTimes times;
+
+private:
+    void generate();
+    void extend();
+    void shade();
+    void connect();
+
+    const Scene& scene;
+    const int batchSize;
+    const uint64_t seed;
+
+    // tile being rendered and the next (pixel, sample) pair to generate
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0, spp = 1;
+    uint64_t sampleOffset = 0;
+    const CameraFn* camera = nullptr;
+    long long nextSample = 0, totalSamples = 0;
+
+    // per path
+    std::vector<int> pixel;
+    std::vector<Sampler> samplers;
+    std::vector<Vector3f> radiance, throughput;
+    std::vector<int> depth;
+    std::vector<float> bsdfPdf;           // pdf of the BSDF sample that made the current ray
+    std::vector<int> freeSlots, finished;
+
+    // extend queue: rays to trace, and the hit written back for each of them
+    std::vector<int> rayPath;
+    std::vector<Vector3f> rayOrigin, rayDir;
+    std::vector<Vector3f> hitPos, hitNormal, hitGeometricNormal;
+    std::vector<Material*> hitMaterial;
+    std::vector<int> nextPath;
+    std::vector<Vector3f> nextOrigin, nextDir;
+
+    // shading queue: indices into the extend queue, sorted by material
+    std::vector<int> shadeQueue;
+
+    // connect queue: shadow rays and the radiance they carry if unoccluded
+    std::vector<int> shadowPath;
+    std::vector<Vector3f> shadowOrigin, shadowDir, shadowContribution;
+    std::vector<float> shadowTMax;
+
+    std::vector<Vector3f>* framebuffer = nullptr;
+};
+
+#endif //RAYTRACING_WAVEFRONT_H
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <limits>
+#include "WideBVH.hpp"
+#include "BVH.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RT_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RT_TARGET_AVX2
+#else
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+template <int N>
+int intersectScalar(const WideBVHNode<N>& node, const WideRay& r, float tMax, float* tEnter)
+{
+    int mask = 0;
+    for (int k = 0; k < node.numChildren; ++k) {
+        float tx0 = (node.minX[k] - r.ox) * r.idx, tx1 = (node.maxX[k] - r.ox) * r.idx;
+        float ty0 = (node.minY[k] - r.oy) * r.idy, ty1 = (node.maxY[k] - r.oy) * r.idy;
+        float tz0 = (node.minZ[k] - r.oz) * r.idz, tz1 = (node.maxZ[k] - r.oz) * r.idz;
+        float t0 = std::max(std::min(tx0, tx1), std::max(std::min(ty0, ty1), std::min(tz0, tz1)));
+        float t1 = std::min(std::max(tx0, tx1), std::min(std::max(ty0, ty1), std::max(tz0, tz1)));
+        tEnter[k] = t0;
+        if (t0 <= t1 && t1 >= 0 && t0 <= tMax)
+            mask |= 1 << k;
+    }
+    return mask;
+}
+
+#ifdef RT_X86_SIMD
+// SSE is part of the x86-64 baseline, no runtime check needed
+int intersectSSE(const WideBVHNode<4>& node, const WideRay& r, float tMax, float* tEnter)
+{
+    const __m128 ox = _mm_set1_ps(r.ox), oy = _mm_set1_ps(r.oy), oz = _mm_set1_ps(r.oz);
+    const __m128 idx = _mm_set1_ps(r.idx), idy = _mm_set1_ps(r.idy), idz = _mm_set1_ps(r.idz);
+    __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), idx);
+    __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), idx);
+    __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), idy);
+    __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), idy);
+    __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), idz);
+    __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), idz);
+    __m128 t0 = _mm_max_ps(_mm_min_ps(tx0, tx1), _mm_max_ps(_mm_min_ps(ty0, ty1), _mm_min_ps(tz0, tz1)));
+    __m128 t1 = _mm_min_ps(_mm_max_ps(tx0, tx1), _mm_min_ps(_mm_max_ps(ty0, ty1), _mm_max_ps(tz0, tz1)));
+    _mm_store_ps(tEnter, t0);
+    __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(t0, t1), _mm_cmpge_ps(t1, _mm_setzero_ps())),
+                            _mm_cmple_ps(t0, _mm_set1_ps(tMax)));
+    return _mm_movemask_ps(hit) & ((1 << node.numChildren) - 1);
+}
+
+RT_TARGET_AVX2
+int intersectAVX2(const WideBVHNode<8>& node, const WideRay& r, float tMax, float* tEnter)
+{
+    const __m256 ox = _mm256_set1_ps(r.ox), oy = _mm256_set1_ps(r.oy), oz = _mm256_set1_ps(r.oz);
+    const __m256 idx = _mm256_set1_ps(r.idx), idy = _mm256_set1_ps(r.idy), idz = _mm256_set1_ps(r.idz);
+    __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minX), ox), idx);
+    __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxX), ox), idx);
+    __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minY), oy), idy);
+    __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxY), oy), idy);
+    __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minZ), oz), idz);
+    __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxZ), oz), idz);
+    __m256 t0 = _mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_max_ps(_mm256_min_ps(ty0, ty1), _mm256_min_ps(tz0, tz1)));
+    __m256 t1 = _mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_min_ps(_mm256_max_ps(ty0, ty1), _mm256_max_ps(tz0, tz1)));
+    _mm256_store_ps(tEnter, t0);
+    __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ),
+                                             _mm256_cmp_ps(t1, _mm256_setzero_ps(), _CMP_GE_OQ)),
+                               _mm256_cmp_ps(t0, _mm256_set1_ps(tMax), _CMP_LE_OQ));
+    return _mm256_movemask_ps(hit) & ((1 << node.numChildren) - 1);
+}
+
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+} // namespace
+
+template <int N>
+int WideBVH::collapse(const std::vector<LinearBVHNode>& binaryNodes, int binaryIndex,
+                      std::vector<WideBVHNode<N>>& nodes)
+{
+    // open up the interior slot with the largest surface area until N slots
+    std::vector<int> slots;
+    const LinearBVHNode& first = binaryNodes[binaryIndex];
+    if (first.nPrimitives > 0)
+        slots.push_back(binaryIndex);
+    else
+        slots = {first.childOffset, first.childOffset + 1};
+    while ((int)slots.size() < N) {
+        int best = -1;
+        double bestArea = -1;
+        for (int k = 0; k < (int)slots.size(); ++k) {
+            const LinearBVHNode& n = binaryNodes[slots[k]];
+            if (n.nPrimitives == 0 && n.bounds.SurfaceArea() > bestArea) {
+                bestArea = n.bounds.SurfaceArea();
+                best = k;
+            }
+        }
+        if (best < 0)
+            break;
+        int childOffset = binaryNodes[slots[best]].childOffset;
+        slots[best] = childOffset;
+        slots.push_back(childOffset + 1);
+    }
+
+    int index = (int)nodes.size();
+    nodes.emplace_back();
+    {
+        WideBVHNode<N>& node = nodes[index];
+        const float inf = std::numeric_limits<float>::infinity();
+        for (int k = 0; k < N; ++k) {
+            node.minX[k] = node.minY[k] = node.minZ[k] = inf;
+            node.maxX[k] = node.maxY[k] = node.maxZ[k] = -inf;
+            node.child[k] = -1;
+            node.nPrimitives[k] = 0;
+        }
+        node.numChildren = (uint8_t)slots.size();
+    }
+    for (int k = 0; k < (int)slots.size(); ++k) {
+        const LinearBVHNode& b = binaryNodes[slots[k]];
+        int child = b.nPrimitives > 0 ? b.primitivesOffset : collapse<N>(binaryNodes, slots[k], nodes);
+        WideBVHNode<N>& node = nodes[index];
+        node.minX[k] = b.bounds.pMin.x; node.minY[k] = b.bounds.pMin.y; node.minZ[k] = b.bounds.pMin.z;
+        node.maxX[k] = b.bounds.pMax.x; node.maxY[k] = b.bounds.pMax.y; node.maxZ[k] = b.bounds.pMax.z;
+        node.child[k] = child;
+        node.nPrimitives[k] = b.nPrimitives;
+    }
+    return index;
+}
+
+void WideBVH::build(const std::vector<LinearBVHNode>& binaryNodes, int width)
+{
+    this->width = width;
+    nodes4.clear();
+    nodes8.clear();
+    if (binaryNodes.empty())
+        return;
+
+    if (width == 4) {
+        collapse<4>(binaryNodes, 0, nodes4);
+        kernel4 = intersectScalar<4>;
+        isa = "scalar";
+#ifdef RT_X86_SIMD
+        kernel4 = intersectSSE;
+        isa = "SSE";
+#endif
+    }
+    else {
+        collapse<8>(binaryNodes, 0, nodes8);
+        kernel8 = intersectScalar<8>;
+        isa = "scalar";
+#ifdef RT_X86_SIMD
+        if (cpuHasAVX2()) {
+            kernel8 = intersectAVX2;
+            isa = "AVX2";
+        }
+#endif
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef RAYTRACING_WIDEBVH_H
+#define RAYTRACING_WIDEBVH_H
+
+#include <cstdint>
+#include <vector>
+#include "Ray.hpp"
+#include "Bounds3.hpp"
+#include "Stats.hpp"
+
+struct LinearBVHNode;
+
+// N-wide node with its child boxes stored as SoA so one ray is tested against
+// all N boxes in a single SIMD pass. child[k] is the index of a wide node when
+// nPrimitives[k] == 0, otherwise the first primitive of a leaf.
+template <int N>
+struct alignas(N * 4) WideBVHNode {
+    float minX[N], minY[N], minZ[N];
+    float maxX[N], maxY[N], maxZ[N];
+    int32_t child[N];
+    uint16_t nPrimitives[N];
+    uint8_t numChildren;
+};
+
+struct WideRay {
+    float ox, oy, oz;
+    float idx, idy, idz;
+};
+
+// BVH4 / BVH8 produced by collapsing the flattened binary BVH. The slab test
+// kernel is chosen once at build time from CPUID: SSE for BVH4, AVX2 for
+// BVH8, and a scalar loop when the ISA is not available.
+class WideBVH
+{
+public:
+    void build(const std::vector<LinearBVHNode>& binaryNodes, int width);
+    bool empty() const { return nodes4.empty() && nodes8.empty(); }
+    const char* isaName() const { return isa; }
+
+    template <typename LeafFn>
+    void traverse(const Ray& ray, const float& tMax, LeafFn&& leaf) const
+    {
+        if (width == 4)
+            traverseN<4>(nodes4, kernel4, ray, tMax, leaf);
+        else
+            traverseN<8>(nodes8, kernel8, ray, tMax, leaf);
+    }
+
+    // hit mask of the node's children, entry distances written to tEnter
+    template <int N>
+    using Kernel = int (*)(const WideBVHNode<N>& node, const WideRay& ray, float tMax, float* tEnter);
+
+private:
+    template <int N>
+    int collapse(const std::vector<LinearBVHNode>& binaryNodes, int binaryIndex,
+                 std::vector<WideBVHNode<N>>& nodes);
+
+    template <int N, typename LeafFn>
+    static void traverseN(const std::vector<WideBVHNode<N>>& nodes, Kernel<N> kernel,
+                          const Ray& ray, const float& tMax, LeafFn& leaf)
+    {
+        if (nodes.empty())
+            return;
+        WideRay r{ray.origin.x, ray.origin.y, ray.origin.z,
+                  ray.direction_inv.x, ray.direction_inv.y, ray.direction_inv.z};
+
+        struct StackEntry {
+            int index, nPrimitives;
+            float tEnter;
+        };
+        StackEntry stack[64 * (N - 1) + 1];
+        int top = 0;
+        stack[top++] = {0, 0, 0.f};
+        while (top > 0) {
+            StackEntry entry = stack[--top];
+            if (entry.tEnter > tMax)
+                continue;
+            if (entry.nPrimitives > 0) {
+                STAT(Stats::local().primitiveTests += entry.nPrimitives);
+                if (leaf(entry.index, entry.nPrimitives))
+                    return;
+                continue;
+            }
+            const WideBVHNode<N>& node = nodes[entry.index];
+            STAT(++Stats::local().nodesVisited; Stats::local().boxTests += N);
+            alignas(32) float tEnter[N];
+            int mask = kernel(node, r, tMax, tEnter);
+
+            // push the hit children far to near so the nearest is popped first
+            StackEntry hits[N];
+            int count = 0;
+            for (int k = 0; k < N; ++k) {
+                if (!(mask & (1 << k)))
+                    continue;
+                StackEntry e{node.child[k], node.nPrimitives[k], tEnter[k]};
+                int j = count++;
+                while (j > 0 && hits[j - 1].tEnter < e.tEnter) {
+                    hits[j] = hits[j - 1];
+                    --j;
+                }
+                hits[j] = e;
+            }
+            for (int k = 0; k < count; ++k)
+                stack[top++] = hits[k];
+        }
+    }
+
+    int width = 2;
+    const char* isa = "none";
+    std::vector<WideBVHNode<4>> nodes4;
+    std::vector<WideBVHNode<8>> nodes8;
+    Kernel<4> kernel4 = nullptr;
+    Kernel<8> kernel8 = nullptr;
+};
+
+#endif //RAYTRACING_WIDEBVH_H
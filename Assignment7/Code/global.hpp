@@ -1,7 +1,7 @@
 #pragma once
 #include <iostream>
 #include <cmath>
-#include <random>
+#include "Sampler.hpp"
 
 #undef M_PI
 #define M_PI 3.141592653589793f
@@ -12,6 +12,13 @@ const float kInfinity = std::numeric_limits<float>::max();
 inline float clamp(const float &lo, const float &hi, const float &v)
 { return std::max(lo, std::min(hi, v)); }
 
+// MIS power heuristic (beta = 2) for one sample from each of two strategies
+inline float powerHeuristic(float pdfA, float pdfB)
+{
+    float a = pdfA * pdfA, b = pdfB * pdfB;
+    return a + b > 0 ? a / (a + b) : 0.0f;
+}
+
 inline  bool solveQuadratic(const float &a, const float &b, const float &c, float &x0, float &x1)
 {
     float discr = b * b - 4 * a * c;
@@ -28,15 +35,6 @@ inline  bool solveQuadratic(const float &a, const float &b, const float &c, floa
     return true;
 }
 
-inline float get_random_float()
-{
-    std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_real_distribution<float> dist(0.f, 1.f); // distribution in range [1, 6]
-
-    return dist(rng);
-}
-
 inline void UpdateProgress(float progress)
 {
     int barWidth = 70;
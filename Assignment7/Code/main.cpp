@@ -1,18 +1,95 @@
 #include "Renderer.hpp"
 #include "Scene.hpp"
 #include "Triangle.hpp"
+#include "Instance.hpp"
 #include "Matrix.hpp"
 #include "Sphere.hpp"
 #include "Vector.hpp"
 #include "global.hpp"
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 // In the main function of the program, we create the scene (create objects and
 // lights) as well as set the options for the render (image width and height,
 // maximum recursion depth, field-of-view, etc.). We then call the render
 // function().
+//
+// usage: RayTracing [--spp N] [--passes N] [--seed N] [--wavefront]
+//                   [--adaptive [threshold]] [--time-budget seconds]
+//                   [--denoise] [--aovs]
+//                   [--checkpoint file] [--checkpoint-interval seconds]
+//                   [--crop x0,y0,x1,y1] [--tiles begin,end] [--sample-offset N]
+// e.g. two processes each rendering half of the frame, or half of the samples:
+//   RayTracing --crop 0,0,784,392 --checkpoint top.ckpt
+//   RayTracing --crop 0,392,784,784 --checkpoint bottom.ckpt
+//   RayTracing --passes 4 --checkpoint a.ckpt
+//   RayTracing --passes 4 --sample-offset 1024 --checkpoint b.ckpt
+// and MergeCheckpoints combines the partials. --wavefront traces the paths
+// with the wavefront integrator instead of one at a time. --adaptive replaces
+// the fixed passes with adaptive sampling down to a relative error
+// threshold (default 0.02); --time-budget also turns it on and stops it after
+// that many seconds. --denoise also writes binary_denoised.ppm, --aovs the
+// albedo/normal/depth images.
 int main(int argc, char** argv)
 {
+    Renderer r;
+    for (int a = 1; a < argc; ++a) {
+        const char* arg = argv[a];
+        // switches, without a value
+        if (!strcmp(arg, "--wavefront")) {
+            r.integrator = Renderer::IntegratorMode::WAVEFRONT;
+            continue;
+        }
+        if (!strcmp(arg, "--denoise")) {
+            r.denoise = true;
+            continue;
+        }
+        if (!strcmp(arg, "--aovs")) {
+            r.writeAOVs = true;
+            continue;
+        }
+        if (!strcmp(arg, "--adaptive")) {
+            r.adaptive.enabled = true;
+            // the threshold is optional
+            if (a + 1 < argc && strncmp(argv[a + 1], "--", 2) != 0)
+                r.adaptive.errorThreshold = std::atof(argv[++a]);
+            continue;
+        }
+        const char* value = a + 1 < argc ? argv[a + 1] : nullptr;
+        if (!value) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        ++a;
+        if (!strcmp(arg, "--spp"))
+            r.spp = std::atoi(value);
+        else if (!strcmp(arg, "--passes"))
+            r.numRenders = std::atoi(value);
+        else if (!strcmp(arg, "--seed"))
+            r.seed = std::strtoull(value, nullptr, 10);
+        else if (!strcmp(arg, "--checkpoint"))
+            r.checkpointFile = value;
+        else if (!strcmp(arg, "--checkpoint-interval"))
+            r.checkpointInterval = std::atof(value);
+        else if (!strcmp(arg, "--crop") &&
+                 sscanf(value, "%d,%d,%d,%d", &r.region.x0, &r.region.y0, &r.region.x1, &r.region.y1) == 4)
+            continue;
+        else if (!strcmp(arg, "--tiles") && sscanf(value, "%d,%d", &r.region.tileBegin, &r.region.tileEnd) == 2)
+            continue;
+        else if (!strcmp(arg, "--sample-offset"))
+            r.sampleOffset = std::strtoull(value, nullptr, 10);
+        else if (!strcmp(arg, "--time-budget")) {
+            r.adaptive.enabled = true;
+            r.adaptive.timeBudget = std::atof(value);
+        }
+        else {
+            std::cerr << "Unknown option " << arg << " " << value << "\n";
+            return 1;
+        }
+    }
+
     // Change the definition here to change resolution
     Scene scene(784, 784);
 
@@ -38,10 +115,11 @@ int main(int argc, char** argv)
     MeshTriangle back("../models/back.obj", white);
     // MeshTriangle shortbox("../models/shortbox.obj", white);
     // MeshTriangle tallbox("../models/tallbox.obj", white);
+    // 实例化: 网格在物体空间只加载/建 BVH 一次, 实例只保存变换和材质
     Matrix4f modelMatrix = Matrix4f::Translate(400, 0, 350) * Matrix4f::Scale(15.0f, 15.0f, 15.0f) * Matrix4f::RotateY(225);
-    MeshTriangle nailong("../models/Nailong.obj", yellow_rubber, modelMatrix);
+    Instance nailong(Instance::LoadMesh("../models/Nailong.obj"), yellow_rubber, modelMatrix);
     modelMatrix = Matrix4f::Translate(175, 0, 350) * Matrix4f::Scale(300.0f, 300.0f, 300.0f) *Matrix4f::RotateY(150)*Matrix4f::RotateX(-90);
-    MeshTriangle HanabiBomb("../models/HanabiBomb.obj", white, modelMatrix);
+    Instance HanabiBomb(Instance::LoadMesh("../models/HanabiBomb.obj"), white, modelMatrix);
     
     scene.Add(&light_);
     scene.Add(&left);
@@ -56,8 +134,6 @@ int main(int argc, char** argv)
 
     scene.buildBVH();
 
-    Renderer r;
-
     auto start = std::chrono::system_clock::now();
     r.Render(scene);
     auto stop = std::chrono::system_clock::now();